@@ -0,0 +1,121 @@
+// Host-side benchmarks for the LCD and control paths (env:bench).
+//
+// Every benchmark prints one JSON object per line on stdout, costs are per
+// operation:
+//   host_ns           wall time on the build machine
+//   i2c_transactions  Wire begin/endTransmission pairs
+//   i2c_bytes         payload bytes put on the bus
+//   i2c_bus_us        simulated bus time at the Wire clock (100 kHz)
+//   sim_us            simulated target time: bus time, library delays and
+//                     ADC conversions (104 us each)
+//   serial_bytes      bytes written to Serial
+// The control timer is detached for these so they measure the call alone.
+//
+// control_latency_under_ui then runs the control core from a real-time timer
+// thread while the main thread redraws the screen back to back, and reports
+// how late the control ticks started (tick_late_us_*) against their deadlines.
+//
+// Usage: program [iterations] [latency_duration_ms]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <LiquidCrystal_I2C.h>
+#include <NativeSim.h>
+#include <config.h>
+#include <fixedpoint.h>
+#include <control.h>
+#include <adc.h>
+#include <calibration.h>
+
+void setup();
+void inputHandler();
+void updateScreen();
+
+extern LiquidCrystal_I2C lcd;
+
+volatile fixed_t sink;
+
+template <typename Op>
+void runBench(const char* name, unsigned long iterations, Op op) {
+  op(0);    // warm up, also leaves the LCD in a steady state
+
+  Wire.resetStats();
+  Serial.resetStats();
+  uint64_t simStart_us = simMicros();
+  auto hostStart = std::chrono::steady_clock::now();
+
+  for (unsigned long i = 0; i < iterations; i++) op(i);
+
+  auto hostEnd = std::chrono::steady_clock::now();
+  double n = (double)iterations;
+  double host_ns = std::chrono::duration<double, std::nano>(hostEnd - hostStart).count();
+  const WireStats& wire = Wire.stats();
+
+  printf("{\"name\":\"%s\",\"iterations\":%lu,\"host_ns\":%.1f,"
+         "\"i2c_transactions\":%.2f,\"i2c_bytes\":%.2f,\"i2c_bus_us\":%.1f,"
+         "\"sim_us\":%.1f,\"serial_bytes\":%.2f}\n",
+         name, iterations, host_ns / n,
+         wire.transactions / n, wire.bytes / n, wire.busMicros / n,
+         (simMicros() - simStart_us) / n, Serial.bytesWritten() / n);
+}
+
+int main(int argc, char** argv) {
+  unsigned long iterations = 10000;
+  if (argc > 1) iterations = strtoul(argv[1], nullptr, 10);
+  if (iterations == 0) iterations = 1;
+  unsigned long latencyDuration_ms = 2000;
+  if (argc > 2) latencyDuration_ms = strtoul(argv[2], nullptr, 10);
+
+  simReset();
+  simSetAnalog(NTC_PIN, 512);
+  setup();
+  simDetachTimerInterrupt();
+
+  runBench("lcd.print(str)", iterations, [](unsigned long) { lcd.print("Temp"); });
+  runBench("lcd.print(int)", iterations, [](unsigned long) { lcd.print(215); });
+  runBench("lcd.setCursor", iterations, [](unsigned long i) { lcd.setCursor(i % SCREEN_WIDTH, i % SCREEN_HEIGHT); });
+  runBench("lcd.clear", iterations, [](unsigned long) { lcd.clear(); });
+  runBench("updateScreen", iterations, [](unsigned long) { updateScreen(); });
+
+  runBench("update", iterations, [](unsigned long i) {
+    simSetAnalog(NTC_PIN, 300 + i % 400);
+    adcStart(NTC_PIN);        //in the firmware the tick before, the conversion runs in the background
+    update();
+  });
+  runBench("tempFromAnalog", iterations, [](unsigned long i) { sink = tempFromAnalog(1 + i % 1022); });
+  runBench("tempTableBuild", iterations, [](unsigned long) {
+    static TempTable table;
+    SteinhartHart coefficients;
+    calibrationDefaults(&coefficients);
+    tempTableBuild(&table, coefficients);
+  });
+  runBench("controlTick", iterations, [](unsigned long) { controlTick(); });
+
+  controlStart();
+  simResetTimerStats();
+  simSetRealTime(true);
+  uint64_t start_us = simMicros();
+  unsigned long frames = 0;
+  while (simMicros() - start_us < latencyDuration_ms * 1000) {
+    inputHandler();
+    updateScreen();
+    frames++;
+  }
+  uint64_t elapsed_us = simMicros() - start_us;
+  simSetRealTime(false);
+  simDetachTimerInterrupt();
+
+  SimTimerStats ticks = simTimerStats();
+  printf("{\"name\":\"control_latency_under_ui\",\"duration_ms\":%.1f,\"ui_frames\":%lu,"
+         "\"tick_period_us\":%lu,\"ticks\":%lu,\"missed_ticks\":%lu,"
+         "\"tick_late_us_mean\":%.1f,\"tick_late_us_max\":%llu}\n",
+         elapsed_us / 1000.0, frames, 1000000UL / CONTROL_TICK_HZ, ticks.ticks, ticks.missed,
+         ticks.ticks ? (double)ticks.lateTotal_us / ticks.ticks : 0.0,
+         (unsigned long long)ticks.lateMax_us);
+
+  return 0;
+}
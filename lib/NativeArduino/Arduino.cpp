@@ -0,0 +1,246 @@
+#include "Arduino.h"
+#include "NativeSim.h"
+#include "EEPROM.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+typedef std::chrono::steady_clock HostClock;
+
+static uint64_t simClock_us = 0;
+static int inputLevel[NUM_DIGITAL_PINS];
+static int analogLevel[NUM_DIGITAL_PINS];
+static int outputLevel[NUM_DIGITAL_PINS];
+static unsigned long outputWrites[NUM_DIGITAL_PINS];
+static uint64_t outputHighSince_us[NUM_DIGITAL_PINS];
+static uint64_t outputHigh_us[NUM_DIGITAL_PINS];
+static unsigned long analogReads[NUM_DIGITAL_PINS];
+static void (*analogReadHook)(uint8_t) = nullptr;
+
+static void (*timerHandler)() = nullptr;
+static unsigned long timerPeriod_us = 0;
+static uint64_t timerDeadline_us = 0;
+static bool inTimerHandler = false;
+static SimTimerStats timerStats;
+static std::mutex timerStatsLock;
+
+static std::atomic<bool> realTime(false);
+static HostClock::time_point realTimeOrigin;
+static uint64_t realTimeOffset_us = 0;
+static std::thread timerThread;
+static std::atomic<bool> timerThreadRunning(false);
+
+#define MILLIS_TICK_US 1024         // timer0 overflow period at 16 MHz
+static uint64_t idle_us = 0;
+
+static bool validPin(uint8_t pin) { return pin < NUM_DIGITAL_PINS; }
+
+static void recordTick(uint64_t late_us, unsigned long missed) {
+  std::lock_guard<std::mutex> guard(timerStatsLock);
+  timerStats.ticks++;
+  timerStats.missed += missed;
+  timerStats.lateTotal_us += late_us;
+  if (late_us > timerStats.lateMax_us) timerStats.lateMax_us = late_us;
+}
+
+static void runTimerThread() {
+  const auto period = std::chrono::microseconds(timerPeriod_us);
+  auto deadline = HostClock::now();
+  while (timerThreadRunning) {
+    deadline += period;
+    std::this_thread::sleep_until(deadline);
+    auto late = HostClock::now() - deadline;
+
+    // A pending AVR interrupt flag doesn't queue up either, drop what was missed
+    unsigned long missed = 0;
+    if (late >= period) {
+      missed = late / period;
+      deadline += period * missed;
+    }
+    recordTick(std::chrono::duration_cast<std::chrono::microseconds>(late).count(), missed);
+    timerHandler();
+  }
+}
+
+static void startTimerThread() {
+  if (!realTime || timerHandler == nullptr || timerThreadRunning) return;
+  timerThreadRunning = true;
+  timerThread = std::thread(runTimerThread);
+}
+
+static void stopTimerThread() {
+  if (!timerThreadRunning) return;
+  timerThreadRunning = false;
+  timerThread.join();
+}
+
+void simReset() {
+  simSetRealTime(false);
+  simDetachTimerInterrupt();
+  simResetTimerStats();
+  simClock_us = 0;
+  idle_us = 0;
+  analogReadHook = nullptr;
+  for (int i = 0; i < NUM_DIGITAL_PINS; i++) {
+    inputLevel[i] = HIGH;       // every input in this project is pulled up
+    analogLevel[i] = 0;
+    outputLevel[i] = LOW;
+    outputWrites[i] = 0;
+    outputHighSince_us[i] = 0;
+    outputHigh_us[i] = 0;
+    analogReads[i] = 0;
+  }
+}
+
+uint64_t simMicros() {
+  if (!realTime) return simClock_us;
+  auto elapsed = HostClock::now() - realTimeOrigin;
+  return realTimeOffset_us + std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void simAdvanceMicros(unsigned long us) {
+  if (realTime) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+    return;
+  }
+
+  uint64_t target_us = simClock_us + us;
+  while (timerHandler != nullptr && !inTimerHandler && timerDeadline_us <= target_us) {
+    simClock_us = timerDeadline_us;
+    timerDeadline_us += timerPeriod_us;
+    recordTick(0, 0);
+    inTimerHandler = true;
+    timerHandler();
+    inTimerHandler = false;
+  }
+  simClock_us = target_us;
+}
+
+void simSleepUntilInterrupt() {
+  uint64_t start_us = simMicros();
+  unsigned long wake_us = MILLIS_TICK_US - start_us % MILLIS_TICK_US;
+  if (!realTime && timerHandler != nullptr && timerDeadline_us - start_us < wake_us) {
+    wake_us = timerDeadline_us - start_us;
+  }
+  if (realTime && timerHandler != nullptr && timerPeriod_us < wake_us) wake_us = timerPeriod_us;
+
+  simAdvanceMicros(wake_us);
+  idle_us += simMicros() - start_us;
+}
+
+uint64_t simIdleMicros() { return idle_us; }
+
+void simSetRealTime(bool enable) {
+  if (enable == realTime) return;
+  if (enable) {
+    realTimeOffset_us = simClock_us;
+    realTimeOrigin = HostClock::now();
+    realTime = true;
+    startTimerThread();
+  }
+  else {
+    stopTimerThread();
+    simClock_us = simMicros();
+    realTime = false;
+    timerDeadline_us = simClock_us + timerPeriod_us;
+  }
+}
+
+void simAttachTimerInterrupt(void (*handler)(), unsigned long period_us) {
+  simDetachTimerInterrupt();
+  if (handler == nullptr || period_us == 0) return;
+  timerHandler = handler;
+  timerPeriod_us = period_us;
+  timerDeadline_us = simClock_us + period_us;
+  startTimerThread();
+}
+
+void simDetachTimerInterrupt() {
+  stopTimerThread();
+  timerHandler = nullptr;
+}
+
+SimTimerStats simTimerStats() {
+  std::lock_guard<std::mutex> guard(timerStatsLock);
+  return timerStats;
+}
+
+void simResetTimerStats() {
+  std::lock_guard<std::mutex> guard(timerStatsLock);
+  timerStats = SimTimerStats();
+}
+
+void simSetAnalog(uint8_t pin, int value) { if (validPin(pin)) analogLevel[pin] = value; }
+void simSetDigital(uint8_t pin, int value) { if (validPin(pin)) inputLevel[pin] = value; }
+void simSetAnalogReadHook(void (*hook)(uint8_t pin)) { analogReadHook = hook; }
+
+static struct SimPowerOn { SimPowerOn() { simReset(); } } simPowerOn;
+
+int simPinLevel(uint8_t pin) { return validPin(pin) ? outputLevel[pin] : LOW; }
+unsigned long simPinWrites(uint8_t pin) { return validPin(pin) ? outputWrites[pin] : 0; }
+unsigned long simAnalogReads(uint8_t pin) { return validPin(pin) ? analogReads[pin] : 0; }
+
+uint64_t simPinHighMicros(uint8_t pin) {
+  if (!validPin(pin)) return 0;
+  uint64_t total = outputHigh_us[pin];
+  if (outputLevel[pin] == HIGH) total += simMicros() - outputHighSince_us[pin];
+  return total;
+}
+
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (validPin(pin) && mode == INPUT_PULLUP) inputLevel[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (!validPin(pin)) return;
+  int level = val ? HIGH : LOW;
+  if (level != outputLevel[pin]) {
+    uint64_t now_us = simMicros();
+    if (level == HIGH) outputHighSince_us[pin] = now_us;
+    else outputHigh_us[pin] += now_us - outputHighSince_us[pin];
+  }
+  outputLevel[pin] = level;
+  outputWrites[pin]++;
+}
+
+int digitalRead(uint8_t pin) { return validPin(pin) ? inputLevel[pin] : LOW; }
+// Uno: 13 ADC clocks at 16 MHz/128 = 125 kHz, analogRead() busy-waits for them
+#define ADC_CONVERSION_US 104
+
+int analogRead(uint8_t pin) {
+  if (!validPin(pin)) return 0;
+  analogReads[pin]++;
+  if (analogReadHook) analogReadHook(pin);
+  simAdvanceMicros(ADC_CONVERSION_US);
+  return analogLevel[pin];
+}
+
+static uint8_t conversionPin = 0;
+static int conversionResult = 0;
+
+void simAnalogStart(uint8_t pin) {
+  if (!validPin(pin)) return;
+  conversionPin = pin;
+  conversionResult = analogLevel[pin];
+}
+
+int simAnalogResult() {
+  analogReads[conversionPin]++;
+  if (analogReadHook) analogReadHook(conversionPin);
+  return conversionResult;
+}
+
+void analogWrite(uint8_t pin, int val) { digitalWrite(pin, val >= 128 ? HIGH : LOW); }
+
+// The AVR counters are 32 bit and wrap; keep that so overflow handling is exercised.
+unsigned long millis(void) { return (uint32_t)(simMicros() / 1000); }
+unsigned long micros(void) { return (uint32_t)simMicros(); }
+
+void delay(unsigned long ms) { simAdvanceMicros(ms * 1000); }
+void delayMicroseconds(unsigned int us) { simAdvanceMicros(us); }
@@ -0,0 +1,56 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host-side replacement for the Arduino core, only used by the native envs.
+// Time is simulated: millis()/micros() only move when delay(), the Wire bus,
+// analogRead() or the harness (NativeSim.h) advance the clock.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <cstdlib>
+
+#include "Print.h"
+#include "HardwareSerial.h"
+
+using std::abs;     // the AVR core uses a macro; keep float arguments as floats
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define NUM_DIGITAL_PINS 20
+
+#define B00000001 1
+#define B00000010 2
+#define B00000100 4
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define NATIVE_EEPROM_SIZE 1024     // ATmega328P
+
+// RAM-backed EEPROM, erased (0xFF) at start-up like a fresh chip.
+class EEPROMClass {
+public:
+  EEPROMClass() { memset(_data, 0xFF, sizeof(_data)); }
+
+  uint8_t read(int idx) const { return valid(idx) ? _data[idx] : 0xFF; }
+  void write(int idx, uint8_t val) { if (valid(idx)) { _data[idx] = val; _writes++; } }
+  void update(int idx, uint8_t val) { if (read(idx) != val) write(idx, val); }
+  uint16_t length() const { return NATIVE_EEPROM_SIZE; }
+
+  template <typename T> T& get(int idx, T& t) const {
+    uint8_t* ptr = (uint8_t*)&t;
+    for (unsigned int i = 0; i < sizeof(T); i++) ptr[i] = read(idx + i);
+    return t;
+  }
+  template <typename T> const T& put(int idx, const T& t) {
+    const uint8_t* ptr = (const uint8_t*)&t;
+    for (unsigned int i = 0; i < sizeof(T); i++) update(idx + i, ptr[i]);
+    return t;
+  }
+
+  unsigned long writes() const { return _writes; }
+
+private:
+  bool valid(int idx) const { return idx >= 0 && idx < NATIVE_EEPROM_SIZE; }
+  uint8_t _data[NATIVE_EEPROM_SIZE];
+  unsigned long _writes = 0;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Print.h"
+
+// Output is discarded; only the byte count is kept so harnesses can see how
+// much UART traffic an operation causes.
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { _baud = baud; }
+  void end() {}
+  virtual size_t write(uint8_t) { _bytesWritten++; return 1; }
+  using Print::write;
+
+  unsigned long baud() const { return _baud; }
+  unsigned long bytesWritten() const { return _bytesWritten; }
+  void resetStats() { _bytesWritten = 0; }
+
+private:
+  unsigned long _baud = 0;
+  unsigned long _bytesWritten = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
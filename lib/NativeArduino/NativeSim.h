@@ -0,0 +1,50 @@
+#ifndef NativeSim_h
+#define NativeSim_h
+
+#include <stdint.h>
+
+// Harness side of the native Arduino stand-in: drives the simulated clock
+// and the pin levels the firmware reads back.
+
+void simReset();
+void simAdvanceMicros(unsigned long us);
+uint64_t simMicros();
+
+void simSetAnalog(uint8_t pin, int value);
+void simSetDigital(uint8_t pin, int value);
+void simSetAnalogReadHook(void (*hook)(uint8_t pin));
+
+int simPinLevel(uint8_t pin);           // last value written by the firmware
+unsigned long simPinWrites(uint8_t pin);
+uint64_t simPinHighMicros(uint8_t pin); // total time the firmware held the pin HIGH
+unsigned long simAnalogReads(uint8_t pin);
+
+// Background ADC conversion (the control core's adc.h): the input is sampled
+// at the start and the result is collected later without waiting, so unlike
+// analogRead() neither call advances the clock. Collecting counts as the read.
+void simAnalogStart(uint8_t pin);
+int simAnalogResult();
+
+// Timer interrupt emulation. In simulated time the handler runs whenever the
+// clock is advanced past its deadline, preempting whatever advanced it (a
+// delay, an I2C transfer). In real time it runs on its own thread, paced by
+// the host clock, while the calling thread keeps running the main loop.
+struct SimTimerStats {
+  unsigned long ticks;
+  unsigned long missed;         // deadlines skipped because the handler ran late
+  uint64_t lateMax_us;          // worst delay between deadline and handler start
+  uint64_t lateTotal_us;
+};
+
+void simAttachTimerInterrupt(void (*handler)(), unsigned long period_us);
+void simDetachTimerInterrupt();
+void simSetRealTime(bool realTime);     // delay(), Wire and simAdvanceMicros() then sleep for real
+
+// CPU idle sleep: returns after the next interrupt, the timer or the ~1 ms
+// millis() tick that always runs on the target. Time spent here is counted.
+void simSleepUntilInterrupt();
+uint64_t simIdleMicros();
+SimTimerStats simTimerStats();
+void simResetTimerStats();
+
+#endif
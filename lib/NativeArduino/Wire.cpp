@@ -0,0 +1,38 @@
+#include "Wire.h"
+#include "NativeSim.h"
+
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t address) {
+  (void)address;
+  _transmitting = true;
+  _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  (void)data;
+  if (!_transmitting || _txLength >= BUFFER_LENGTH) return 0;
+  _txLength++;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+  size_t n = 0;
+  while (quantity--) n += write(*data++);
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  // START + (address + payload) * (8 data bits + ACK) + STOP
+  unsigned long bits = 1 + 9ul * (1 + _txLength) + (sendStop ? 1 : 0);
+  unsigned long us = (bits * 1000000ul + _clock - 1) / _clock;
+
+  _stats.transactions++;
+  _stats.bytes += _txLength;
+  _stats.busMicros += us;
+  simAdvanceMicros(us);
+
+  _transmitting = false;
+  _txLength = 0;
+  return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BUFFER_LENGTH 32
+
+struct WireStats {
+  unsigned long transactions;
+  unsigned long bytes;          // payload bytes, address byte excluded
+  unsigned long busMicros;      // simulated time the bus was held
+};
+
+// Write-only I2C master. Every endTransmission() is charged its bus time at
+// the configured clock and advances the simulated clock by the same amount,
+// the same way the blocking AVR implementation stalls the caller.
+class TwoWire {
+public:
+  void begin() { _clock = 100000; }
+  void setClock(uint32_t clock) { _clock = clock; }
+
+  void beginTransmission(uint8_t address);
+  void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+  uint8_t endTransmission(bool sendStop = true);
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t quantity);
+  inline size_t write(unsigned long n) { return write((uint8_t)n); }
+  inline size_t write(long n) { return write((uint8_t)n); }
+  inline size_t write(unsigned int n) { return write((uint8_t)n); }
+  inline size_t write(int n) { return write((uint8_t)n); }
+
+  const WireStats& stats() const { return _stats; }
+  void resetStats() { _stats = WireStats(); }
+
+private:
+  uint32_t _clock = 100000;
+  uint8_t _txLength = 0;
+  bool _transmitting = false;
+  WireStats _stats = WireStats();
+};
+
+extern TwoWire Wire;
+
+#endif
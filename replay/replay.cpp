@@ -0,0 +1,246 @@
+// Replays recorded input traces into the control logic off-target (env:replay).
+//
+// The firmware runs unmodified on top of lib/NativeArduino: loop() is called
+// over and over on the simulated clock, the control core ticks from the
+// emulated timer interrupt and the trace drives the pins both read. Each
+// trace runs in its own process so every run starts from a freshly
+// initialised firmware, and one JSON line of metrics is printed per trace on
+// stdout. fork(), waitpid() and getopt() make this POSIX-only (Linux, macOS).
+//
+// The replay is open loop: the temperature comes from the recorded ADC
+// samples, nothing models the heater warming the part. Settling, overshoot
+// and steady-state error therefore describe the recording, not the firmware
+// under test; only heater_duty and the timing metrics (cpu_idle,
+// update_period_ms, loop_period_us) respond to changes in the controller.
+//
+// Trace format, one sample per line, '#' starts a comment:
+//   time_ms,adc,encoder_a,encoder_b,encoder_button,heat_button,motor_button,fan_button
+// Samples are held until the next one; inputs not yet sampled read HIGH.
+// traces/example.csv is a synthetic trace in this format.
+//
+// Usage: program [-b band_C] [-c loop_cost_us] trace...
+//   -b  settling band around the setpoint (default 2.0 C)
+//   -c  simulated CPU time charged per UI loop() on top of bus and delay time
+//       (default 200 us)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <Arduino.h>
+#include <NativeSim.h>
+#include <config.h>
+#include <state.h>
+
+void setup();
+void loop();
+
+struct TraceSample {
+  unsigned long time_ms;
+  int adc;
+  int level[6];
+};
+
+static const uint8_t tracePins[6] = {
+  ENCODER_PIN_A, ENCODER_PIN_B, ENCODER_BUTTON_PIN,
+  TOGGLE_HEAT_BUTTON, TOGGLE_MOTOR_BUTTON, TOGGLE_FAN_BUTTON
+};
+
+struct ControlSample {
+  double time_ms;
+  double temp;
+  double setpoint;
+};
+
+struct RunningStats {
+  unsigned long count = 0;
+  double min = 0, max = 0, sum = 0, sumSq = 0;
+
+  void add(double v) {
+    if (count == 0 || v < min) min = v;
+    if (count == 0 || v > max) max = v;
+    count++;
+    sum += v;
+    sumSq += v * v;
+  }
+  double mean() const { return count ? sum / count : 0; }
+  double stddev() const {
+    if (count < 2) return 0;
+    double m = mean();
+    double var = sumSq / count - m * m;
+    return var > 0 ? sqrt(var) : 0;
+  }
+};
+
+float settlingBand_C = 2.0;
+unsigned long loopCost_us = 200;
+
+uint64_t lastNtcRead_us = 0;
+
+void recordNtcRead(uint8_t pin) {
+  if (pin == NTC_PIN) lastNtcRead_us = simMicros();
+}
+
+
+bool loadTrace(const char* path, std::vector<TraceSample>* trace) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) return false;
+
+  char line[256];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineNumber++;
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    TraceSample s;
+    int fields = sscanf(line, " %lu , %d , %d , %d , %d , %d , %d , %d", &s.time_ms, &s.adc,
+                        &s.level[0], &s.level[1], &s.level[2], &s.level[3], &s.level[4], &s.level[5]);
+    if (fields <= 0) continue;      // blank or comment-only line
+    if (fields != 8 || (!trace->empty() && s.time_ms < trace->back().time_ms)) {
+      fprintf(stderr, "%s:%d: malformed sample\n", path, lineNumber);
+      fclose(f);
+      return false;
+    }
+    trace->push_back(s);
+  }
+  fclose(f);
+  return !trace->empty();
+}
+
+void printMetrics(const char* path, const std::vector<TraceSample>& trace,
+                  const std::vector<ControlSample>& control, double heaterOn_ms, double idle_ms, double duration_ms,
+                  const RunningStats& updatePeriod, const RunningStats& loopPeriod) {
+  // Settling is measured from the last setpoint change (or the start of the run).
+  size_t stepIndex = 0;
+  for (size_t i = 1; i < control.size(); i++) {
+    if (control[i].setpoint != control[i - 1].setpoint) stepIndex = i;
+  }
+
+  double settling_ms = -1;
+  double overshoot = 0;
+  if (!control.empty()) {
+    const ControlSample& step = control[stepIndex];
+    bool rising = step.setpoint >= step.temp;
+    for (size_t i = stepIndex; i < control.size(); i++) {
+      double error = control[i].temp - control[i].setpoint;
+      double beyond = rising ? error : -error;
+      if (beyond > overshoot) overshoot = beyond;
+      if (fabs(error) > settlingBand_C) settling_ms = -1;
+      else if (settling_ms < 0) settling_ms = control[i].time_ms - step.time_ms;
+    }
+  }
+
+  // Steady-state error over the final 10% of the run.
+  double tailStart_ms = duration_ms * 0.9;
+  double tailError = 0;
+  unsigned long tailCount = 0;
+  for (const ControlSample& c : control) {
+    if (c.time_ms < tailStart_ms) continue;
+    tailError += c.temp - c.setpoint;
+    tailCount++;
+  }
+
+  printf("{\"trace\":\"%s\",\"samples\":%zu,\"duration_ms\":%.0f,\"control_updates\":%zu,"
+         "\"setpoint_C\":%.2f,\"settling_ms\":%.0f,\"overshoot_C\":%.2f,\"steady_state_error_C\":%.3f,"
+         "\"heater_duty\":%.4f,\"cpu_idle\":%.4f,"
+         "\"update_period_ms\":{\"min\":%.3f,\"mean\":%.3f,\"max\":%.3f,\"stddev\":%.3f},"
+         "\"loop_period_us\":{\"min\":%.1f,\"mean\":%.1f,\"max\":%.1f,\"stddev\":%.1f}}\n",
+         path, trace.size(), duration_ms, control.size(),
+         control.empty() ? 0.0 : control.back().setpoint, settling_ms, overshoot,
+         tailCount ? tailError / tailCount : 0.0,
+         duration_ms > 0 ? heaterOn_ms / duration_ms : 0.0,
+         duration_ms > 0 ? idle_ms / duration_ms : 0.0,
+         updatePeriod.min, updatePeriod.mean(), updatePeriod.max, updatePeriod.stddev(),
+         loopPeriod.min, loopPeriod.mean(), loopPeriod.max, loopPeriod.stddev());
+}
+
+int replay(const char* path) {
+  std::vector<TraceSample> trace;
+  if (!loadTrace(path, &trace)) {
+    fprintf(stderr, "%s: could not load trace\n", path);
+    return 1;
+  }
+
+  simReset();
+  simSetAnalog(NTC_PIN, trace[0].adc);
+  simSetAnalogReadHook(recordNtcRead);
+  setup();
+  uint64_t start_us = simMicros();
+  uint64_t end_us = start_us + (uint64_t)trace.back().time_ms * 1000;
+
+  std::vector<ControlSample> control;
+  RunningStats updatePeriod, loopPeriod;
+  uint64_t heaterStart_us = simPinHighMicros(HEATER_PIN);
+  uint64_t idleStart_us = simIdleMicros();
+  double lastUpdate_ms = -1;
+  unsigned long adcReads = simAnalogReads(NTC_PIN);
+  size_t next = 0;
+
+  while (simMicros() <= end_us) {
+    uint64_t now_us = simMicros();
+    while (next < trace.size() && start_us + (uint64_t)trace[next].time_ms * 1000 <= now_us) {
+      simSetAnalog(NTC_PIN, trace[next].adc);
+      for (int i = 0; i < 6; i++) simSetDigital(tracePins[i], trace[next].level[i]);
+      next++;
+    }
+
+    loop();
+    simAdvanceMicros(loopCost_us);
+    loopPeriod.add((double)(simMicros() - now_us));
+
+    // update() reads the NTC exactly once, use that to spot control iterations.
+    if (simAnalogReads(NTC_PIN) != adcReads) {
+      adcReads = simAnalogReads(NTC_PIN);
+      double t_ms = (double)(lastNtcRead_us - start_us) / 1000.0;
+      if (lastUpdate_ms >= 0) updatePeriod.add(t_ms - lastUpdate_ms);
+      lastUpdate_ms = t_ms;
+
+      MachineState snapshot;
+      stateSnapshot(&snapshot);
+      control.push_back({t_ms, FIXED_TO_FLOAT(snapshot.temperature[0]), FIXED_TO_FLOAT(snapshot.temperature[1])});
+    }
+  }
+
+  double heaterOn_ms = (double)(simPinHighMicros(HEATER_PIN) - heaterStart_us) / 1000.0;
+  double idle_ms = (double)(simIdleMicros() - idleStart_us) / 1000.0;
+  printMetrics(path, trace, control, heaterOn_ms, idle_ms, (double)(end_us - start_us) / 1000.0,
+               updatePeriod, loopPeriod);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "b:c:")) != -1) {
+    switch (opt) {
+      case 'b': settlingBand_C = atof(optarg); break;
+      case 'c': loopCost_us = strtoul(optarg, nullptr, 10); break;
+      default:
+        fprintf(stderr, "usage: %s [-b band_C] [-c loop_cost_us] trace...\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-b band_C] [-c loop_cost_us] trace...\n", argv[0]);
+    return 2;
+  }
+
+  int failures = 0;
+  for (int i = optind; i < argc; i++) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      int rc = replay(argv[i]);
+      fflush(stdout);
+      _exit(rc);
+    }
+
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) failures++;
+  }
+  return failures ? 1 : 0;
+}
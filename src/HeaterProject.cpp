@@ -3,44 +3,49 @@
 #include <LiquidCrystal_I2C.h>
 #include <config.h>
 #include <macros.h>
+#include <fixedpoint.h>
+#include <state.h>
+#include <command.h>
+#include <control.h>
+#include <calibration.h>
+#include <idle.h>
 
 // -------------------- FUNCTION DECLARATIONS --------------------
-void update();
 void updateScreen();
 void inputHandler();
 void editmodeToggle();
-float tempFromAnalog(int);
-void setHeatPower(float);
+void calibrationClick();
+void calibrationStatus(Print&);
 
 void millisOverflowHandler(unsigned long*);
 bool softDelay(unsigned long*, unsigned int);
 
 
 // -------------------- GLOBAL VARIABLES --------------------
-volatile float temperature[] = {0.0, 0.0};  //current, set
-volatile float speed[] = {0.0, 0.0};        //current, set
+// Control state lives in the control core (control.cpp), this file is the UI side
+int lastEncoderState = 0;
+int encoderSteps = 0;
+int lastButtonState[4] = {0,0,0,0};     //encoder button, heat, motor, fan
 
-volatile int step = false;
-volatile int dir = true;
+int editMode = false;
+unsigned long lastInputActivity_ms = 0;
 
-volatile int heaterOn = false;
-volatile int motorOn = false;
-volatile int fanOn = false;
-
-volatile int lastEncoderState = 0;
-volatile int encoderSteps = 0;
-
-volatile int editMode = false;
+CalibrationPoint calibrationPoints[CALIBRATION_POINTS];
+uint8_t calibrationCount = 0;
+enum CalibrationResult : uint8_t { CAL_NONE, CAL_SAVED, CAL_FAILED };
+CalibrationResult calibrationResult = CAL_NONE;
 
 char* screenData = nullptr;
 
 // -------------------- MENU --------------------
+#define MENU_MAX_ACTIONS 1      // fixed size, flexible array members can't be initialized inside an array
 struct MenuItem {
   const char* name;
-  int fvalueCount;
-  volatile float* fvaluePtr;
+  int valueCount;
+  uint8_t valueOffset;          // offsetof(MachineState, field), values are fixed_t
   int actionsCount;
-  void (*onClickAction[])();    // void* func_name is a function returning void* , void (*func_name) points to a function returning void
+  void (*onClickAction[MENU_MAX_ACTIONS])();    // void* func_name is a function returning void* , void (*func_name) points to a function returning void
+  void (*printStatus)(Print&);                  // optional, printed after the values
 };
 struct Menu {
   const char* title;
@@ -49,12 +54,13 @@ struct Menu {
 };
 
 MenuItem mainMenuItems[] = {
-  {"Temp", 2, temperature, 1, {editmodeToggle}},
-  {"Speed", 2, speed, 1, {editmodeToggle}}
+  {"Temp", 2, offsetof(MachineState, temperature), 1, {editmodeToggle}, nullptr},
+  {"Speed", 2, offsetof(MachineState, speed), 1, {editmodeToggle}, nullptr},
+  {"Cal", 1, offsetof(MachineState, calibrationReference), 1, {calibrationClick}, calibrationStatus}
 };
 Menu mainMenu = {
   "Main Menu",
-  2,                // Menu item count
+  3,                // Menu item count
   mainMenuItems
 };
 
@@ -99,56 +105,61 @@ void setup() {
   Serial.println("Trying malloc for screenData");
   while(screenData == nullptr) screenData = (char*) malloc(sizeof(char)*SCREEN_WIDTH*SCREEN_HEIGHT);
   Serial.println("ScreenData memory allocated");
+
+  // Start the edge detection from the idle levels, otherwise the pulled-up
+  // inputs read as a press and an encoder step on the first inputHandler()
+  lastEncoderState = digitalRead(ENCODER_PIN_A);
+  lastButtonState[0] = digitalRead(ENCODER_BUTTON_PIN);
+  lastButtonState[1] = digitalRead(TOGGLE_HEAT_BUTTON);
+  lastButtonState[2] = digitalRead(TOGGLE_MOTOR_BUTTON);
+  lastButtonState[3] = digitalRead(TOGGLE_FAN_BUTTON);
+
+  controlStart();
+  idleSetup();
+
+  #ifdef __AVR__
+  // Gap between the heap and the stack, the Uno has 2048 bytes in total
+  extern char __heap_start, *__brkval;
+  char stackTop;
+  Serial.print("Free RAM: ");
+  Serial.println(&stackTop - (__brkval ? __brkval : &__heap_start));
+  #endif
 }
 
+// The control core runs from its timer interrupt, loop() is only the UI
 unsigned long lastScreenRefresh_ms = 0;
-unsigned long lastUpdate_ms = 0;
-unsigned long lastMotorStep_ms = 0;
+bool uiActive = true;
 void loop() {
-  #ifdef HAS_SCREEN
-  if (softDelay(&lastScreenRefresh_ms, SCREEN_REFRESH_MILLISECONDS)) updateScreen();
+  #ifdef IDLE_SLEEP
+  idleInputPolled();
   #endif
+  inputHandler();
 
-  if (softDelay(&lastUpdate_ms, (int)(1000.0/UPDATE_FREQ))) update();
-
-  if (motorOn && softDelay(&lastMotorStep_ms, (int)(1000.0/abs(speed[1])))){
-    step = !step;
-    if (speed[0] >= 0) digitalWrite(MOTOR_DIR_PIN, !INVERT_MOTOR_DIRECTION);
-    else digitalWrite(MOTOR_DIR_PIN, INVERT_MOTOR_DIRECTION);
-    digitalWrite(MOTOR_STEP_PIN, step);
+  #ifdef HAS_SCREEN
+  bool wasActive = uiActive;
+  uiActive = millis() - lastInputActivity_ms < UI_ACTIVE_MILLISECONDS;
+  unsigned int refresh_ms = uiActive ? SCREEN_REFRESH_MILLISECONDS : SCREEN_IDLE_REFRESH_MILLISECONDS;
+  if (softDelay(&lastScreenRefresh_ms, refresh_ms) || (uiActive && !wasActive)) {
+    lastScreenRefresh_ms = millis();
+    updateScreen();
   }
+  #endif
 
-  inputHandler();
+  #ifdef IDLE_SLEEP
+  idleSleep();
+  #endif
 }
 
 
 // -------------------- FUNCTION DEFINITIONS --------------------
-void update(){
-  temperature[0] = tempFromAnalog(analogRead(NTC_PIN));
-  float tempError = temperature[0]-temperature[1];
-  float heatPower = -tempError*(100.0/TEMP_ERROR_MAX);
-  
-  if(heaterOn) setHeatPower(heatPower);
-  else setHeatPower(0);
-  float speedError = speed[0] - speed[1];
-  float accelAddition = (float)MOTOR_ACCELERATION*UPDATE_FREQ/1000.0;
-  if(speedError > accelAddition) speed[0] += accelAddition;
-  else speed[0] = speed[1];
-
-  int lastValIndex = activeMenu->items[activeMenuCursor].fvalueCount - 1;
-  if(editMode) activeMenu->items[activeMenuCursor].fvaluePtr[lastValIndex] = activeMenu->items[activeMenuCursor].fvaluePtr[lastValIndex] + encoderSteps;
-  else activeMenuCursor = (activeMenuCursor+encoderSteps)%activeMenu->itemCount;
-  encoderSteps = 0;
-
-  digitalWrite(FAN_PIN, fanOn);
-
-  return;
-}
-
 void updateScreen() {
+  MachineState snapshot;
+  stateSnapshot(&snapshot);
+
   lcd.clear();
   lcd.setCursor(0, 0);
-  if (editMode) lcd.print(">");
+  if (snapshot.sensorFault) lcd.print("!");      //heater is held off until the reading is back in range
+  else if (editMode) lcd.print(">");
   else lcd.print("-");
 
   for (int i = 0; i < SCREEN_HEIGHT; i++){
@@ -162,22 +173,37 @@ void updateScreen() {
 
     lcd.print(" ");
     Serial.print(": ");
-    for (int j = 0; j < activeItem->fvalueCount; j++){
-      float current_value = activeItem->fvaluePtr[j];
+    const fixed_t* values = STATE_FIELD(&snapshot, activeItem->valueOffset);
+    for (int j = 0; j < activeItem->valueCount; j++){
+      fixed_t current_value = values[j];
       if (j>0) {
         lcd.print("/");
         Serial.print (" / ");
       }
-      lcd.print((int)current_value);
-      Serial.print(current_value);
+      lcd.print(FIXED_TO_INT(current_value));
+      printFixed(Serial, current_value, 2);
+    }
+    if (activeItem->printStatus) {
+      activeItem->printStatus(lcd);
+      activeItem->printStatus(Serial);
     }
   }
+
+  #ifdef __AVR__
+  static uint16_t reportedTickLateMax_us = 0;      //only report a new maximum, not every frame
+  if (snapshot.tickLateMax_us != reportedTickLateMax_us) {
+    reportedTickLateMax_us = snapshot.tickLateMax_us;
+    Serial.print(" | tick late max ");
+    Serial.print(reportedTickLateMax_us);
+    Serial.print("us");
+  }
+  #endif
 }
 
-int lastButtonState[4] = {0,0,0,0};
 void inputHandler(){
   int encoderState = digitalRead(ENCODER_PIN_A);
   if (encoderState != lastEncoderState) {
+    lastInputActivity_ms = millis();
     if (digitalRead(ENCODER_PIN_B) != encoderState) {
       encoderSteps++;
     } else {
@@ -186,9 +212,33 @@ void inputHandler(){
   }
   lastEncoderState = encoderState;
 
+  if (encoderSteps != 0) {
+    MenuItem* activeItem = &activeMenu->items[activeMenuCursor];
+    if (editMode) {
+      Command adjust = {CMD_ADJUST,
+                        (uint8_t)(activeItem->valueOffset + (activeItem->valueCount - 1)*sizeof(fixed_t)),
+                        fixedSaturate((long)encoderSteps*FIXED_ONE)};
+      if (commandPost(adjust)) encoderSteps = 0;   //keep the steps for the next try if the mailbox is full
+    }
+    else {
+      activeMenuCursor = (activeMenuCursor+encoderSteps)%activeMenu->itemCount;
+      if (activeMenuCursor < 0) activeMenuCursor += activeMenu->itemCount;
+      encoderSteps = 0;
+
+      // Leaving Cal abandons a partly captured calibration
+      if (calibrationCount > 0 && activeMenu->items[activeMenuCursor].onClickAction[0] != calibrationClick) {
+        calibrationCount = 0;
+        calibrationResult = CAL_NONE;
+        Serial.println();
+        Serial.println("Calibration cancelled");
+      }
+    }
+  }
+
   int buttonEState = digitalRead(ENCODER_BUTTON_PIN);
   if (buttonEState){
     if(!lastButtonState[0]){
+      lastInputActivity_ms = millis();
       activeMenu->items[activeMenuCursor].onClickAction[0]();
       lastButtonState[0] = buttonEState;
     }
@@ -198,8 +248,8 @@ void inputHandler(){
   int button0State = digitalRead(TOGGLE_HEAT_BUTTON);
   if (button0State){
     if(!lastButtonState[1]){
-      heaterOn = !heaterOn;
-      lastButtonState[1] = button0State;
+      lastInputActivity_ms = millis();
+      if (commandPost({CMD_TOGGLE_HEATER, 0, 0})) lastButtonState[1] = button0State;    //mailbox full: retry next loop
     }
   }
   else lastButtonState[1] = button0State;
@@ -207,8 +257,8 @@ void inputHandler(){
   int button1State = digitalRead(TOGGLE_MOTOR_BUTTON);
   if (button1State){
     if(!lastButtonState[2]){
-      motorOn = !motorOn;
-      lastButtonState[2] = button1State;
+      lastInputActivity_ms = millis();
+      if (commandPost({CMD_TOGGLE_MOTOR, 0, 0})) lastButtonState[2] = button1State;    //mailbox full: retry next loop
     }
   }
   else lastButtonState[2] = button1State;
@@ -216,8 +266,8 @@ void inputHandler(){
   int button2State = digitalRead(TOGGLE_FAN_BUTTON);
   if (button2State){
     if(!lastButtonState[3]){
-      fanOn = !fanOn;
-      lastButtonState[3] = button2State;
+      lastInputActivity_ms = millis();
+      if (commandPost({CMD_TOGGLE_FAN, 0, 0})) lastButtonState[3] = button2State;    //mailbox full: retry next loop
     }
   }
   else lastButtonState[3] = button2State;
@@ -229,43 +279,54 @@ void editmodeToggle(){
   editMode = !editMode;
 }
 
-float tempFromAnalog (int val) {
-  float sensor_resistance = (1023.0*NTC_RESISTOR)/((float)val) - NTC_RESISTOR;
-  float T = log(sensor_resistance/REFERENCE_RESISTANCE);
-  T /= NTC_BETA;
-  T += 1.0 / REFERENCE_TEMP_KELVIN;
-  T = 1.0 / T;
-  return (T - 273.15);
-}
-
-unsigned long lastHeaterOn_ms = 0;
-unsigned long lastHeaterOff_ms = 0;
-void setHeatPower(float percentage) {
-  if (percentage < 0) percentage = 0;
-  if (percentage > 100) percentage = 100;
-  
-  #ifndef HEATER_SWITCH_FREQ
-    analogWrite(MOSFET_PIN, percentage * 255 / 100);
-  #else
-
-  millisOverflowHandler(&lastHeaterOff_ms);
-  int onTime = millis() - lastHeaterOff_ms;
-  int onTimeLimit = (int) (10.0*(float)percentage)/HEATER_SWITCH_FREQ;
-  if (heaterOn && (onTime >= onTimeLimit)) {
-    heaterOn = false;
-    digitalWrite(HEATER_PIN, heaterOn);
-    lastHeaterOn_ms = millis();
+// First click edits the reference temperature, the second captures it together with the NTC reading averaged
+// over the last CALIBRATION_SAMPLES updates. After CALIBRATION_POINTS captures the sensor model is refitted,
+// stored and swapped in. Moving the cursor off Cal in between discards the captured points.
+void calibrationClick(){
+  if (!editMode) {
+    editMode = true;
+    return;
   }
-  millisOverflowHandler(&lastHeaterOn_ms);
-  int offTime = millis() - lastHeaterOn_ms;
-  int offTimeLimit = 1000 - onTimeLimit;
-  if (!heaterOn && (offTime >= offTimeLimit)){
-    heaterOn = true;
-    digitalWrite(HEATER_PIN, heaterOn);
-    lastHeaterOff_ms = millis();
+  editMode = false;
+
+  MachineState snapshot;
+  stateSnapshot(&snapshot);
+  calibrationPoints[calibrationCount].adc = snapshot.ntcAverage;
+  calibrationPoints[calibrationCount].temperature = snapshot.calibrationReference;
+  calibrationCount++;
+  calibrationResult = CAL_NONE;
+
+  Serial.println();
+  Serial.print("Calibration point ");
+  Serial.print(calibrationCount);
+  Serial.print("/");
+  Serial.println(CALIBRATION_POINTS);
+  if (calibrationCount < CALIBRATION_POINTS) return;
+  calibrationCount = 0;
+
+  SteinhartHart coefficients;
+  TempTable* table = controlSpareTempTable();
+  if (!calibrationFit(calibrationPoints, CALIBRATION_POINTS, &coefficients) || !tempTableBuild(table, coefficients)) {
+    Serial.println("Calibration failed, keeping the previous one");
+    calibrationResult = CAL_FAILED;
+    return;
   }
+  calibrationSave(coefficients);
+  while (!commandPost({CMD_SWAP_TEMP_TABLE, 0, 0}));     //the core drains the mailbox every tick
+  Serial.println("Calibration saved");
+  calibrationResult = CAL_SAVED;
+}
 
-  #endif
+// Cal row: capture progress, then the outcome of the last calibration
+void calibrationStatus(Print& out){
+  if (calibrationCount > 0) {
+    out.print(" ");
+    out.print(calibrationCount);
+    out.print("/");
+    out.print(CALIBRATION_POINTS);
+  }
+  else if (calibrationResult == CAL_SAVED) out.print(" ok");
+  else if (calibrationResult == CAL_FAILED) out.print(" fail");
 }
 
 void millisOverflowHandler(unsigned long* millis_ptr){
@@ -0,0 +1,24 @@
+#include <adc.h>
+
+#ifndef __AVR__
+  #include <NativeSim.h>
+#endif
+
+void adcStart(uint8_t pin) {
+  #ifdef __AVR__
+  if (pin >= A0) pin -= A0;                   //channel number, like analogRead()
+  ADMUX = _BV(REFS0) | (pin & 0x07);          //AVcc reference, analogReference(DEFAULT)
+  ADCSRA |= _BV(ADSC);                        //init() already enabled the ADC at clk/128
+  #else
+  simAnalogStart(pin);
+  #endif
+}
+
+int adcResult() {
+  #ifdef __AVR__
+  while (bit_is_set(ADCSRA, ADSC));
+  return ADC;
+  #else
+  return simAnalogResult();
+  #endif
+}
@@ -0,0 +1,12 @@
+#ifndef ADC_H
+#define ADC_H
+
+#include <Arduino.h>
+
+// Split analogRead() for the control core: start the conversion in one tick
+// and collect it in a later one, so the ISR never busy-waits the ~104 us the
+// conversion takes (13 ADC clocks at 125 kHz).
+void adcStart(uint8_t pin);
+int adcResult();        //waits only if called less than one conversion after adcStart()
+
+#endif
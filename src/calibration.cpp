@@ -0,0 +1,141 @@
+#include <stddef.h>
+#include <calibration.h>
+#include <EEPROM.h>
+
+#define CALIBRATION_MAGIC 0x5348    //"SH"
+#define KELVIN_OFFSET 273.15
+
+struct CalibrationRecord {
+  uint16_t magic;
+  SteinhartHart coefficients;
+  uint8_t checksum;
+};
+
+static uint8_t recordChecksum(const CalibrationRecord& record) {
+  const uint8_t* bytes = (const uint8_t*)&record;
+  uint8_t checksum = 0xA5;
+  for (size_t i = 0; i < offsetof(CalibrationRecord, checksum); i++) checksum ^= bytes[i];
+  return checksum;
+}
+
+static float ntcLogResistance(float adc) {
+  return log(NTC_RESISTOR*(1023.0 - adc)/adc);
+}
+
+void calibrationDefaults(SteinhartHart* coefficients) {
+  coefficients->a = 1.0/REFERENCE_TEMP_KELVIN - log(NTC_VALUE)/NTC_BETA;
+  coefficients->b = 1.0/NTC_BETA;
+  coefficients->c = 0;
+}
+
+// Least squares through modified Gram-Schmidt, which stays usable in single
+// precision (the only float on AVR) where the normal equations don't.
+bool calibrationFit(const CalibrationPoint* points, uint8_t count, SteinhartHart* out) {
+  if (count < 3 || count > CALIBRATION_POINTS) return false;
+
+  float q[3][CALIBRATION_POINTS];
+  float y[CALIBRATION_POINTS];
+  float r[3][3] = {{0}};
+  float z[3];
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (points[i].adc == 0 || points[i].adc >= 1023) return false;
+    float L = ntcLogResistance(points[i].adc);
+    q[0][i] = 1;
+    q[1][i] = L;
+    q[2][i] = L*L*L;
+    y[i] = 1.0/(FIXED_TO_FLOAT(points[i].temperature) + KELVIN_OFFSET);
+  }
+
+  for (uint8_t j = 0; j < 3; j++) {
+    float columnNorm = 0;
+    for (uint8_t i = 0; i < count; i++) columnNorm += q[j][i]*q[j][i];
+
+    for (uint8_t k = 0; k < j; k++) {
+      r[k][j] = 0;
+      for (uint8_t i = 0; i < count; i++) r[k][j] += q[k][i]*q[j][i];
+      for (uint8_t i = 0; i < count; i++) q[j][i] -= r[k][j]*q[k][i];
+    }
+
+    float norm = 0;
+    for (uint8_t i = 0; i < count; i++) norm += q[j][i]*q[j][i];
+    if (!(norm > 1e-10*columnNorm)) return false;           //points too close together
+    r[j][j] = sqrt(norm);
+    for (uint8_t i = 0; i < count; i++) q[j][i] /= r[j][j];
+
+    z[j] = 0;
+    for (uint8_t i = 0; i < count; i++) z[j] += q[j][i]*y[i];
+    for (uint8_t i = 0; i < count; i++) y[i] -= z[j]*q[j][i];
+  }
+
+  out->c = z[2]/r[2][2];
+  out->b = (z[1] - r[1][2]*out->c)/r[1][1];
+  out->a = (z[0] - r[0][1]*out->b - r[0][2]*out->c)/r[0][0];
+  return isfinite(out->a) && isfinite(out->b) && isfinite(out->c) && out->b > 0;
+}
+
+bool calibrationLoad(SteinhartHart* coefficients) {
+  CalibrationRecord record;
+  EEPROM.get(CALIBRATION_EEPROM_ADDRESS, record);
+  if (record.magic != CALIBRATION_MAGIC || record.checksum != recordChecksum(record)) return false;
+  *coefficients = record.coefficients;
+  return true;
+}
+
+void calibrationSave(const SteinhartHart& coefficients) {
+  CalibrationRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = CALIBRATION_MAGIC;
+  record.coefficients = coefficients;
+  record.checksum = recordChecksum(record);
+  EEPROM.put(CALIBRATION_EEPROM_ADDRESS, record);
+}
+
+bool tempTableBuild(TempTable* table, const SteinhartHart& sh) {
+  float L = log(NTC_VALUE);
+  for (uint8_t i = 0; i < TEMP_TABLE_SIZE; i++) {
+    float y = 1.0/(TEMP_TABLE_MIN_C + i*TEMP_TABLE_STEP_C + KELVIN_OFFSET);
+
+    // Invert the model for ln(R) with Newton, starting from the previous node
+    for (uint8_t iteration = 0; iteration < 8; iteration++) {
+      float slope = sh.b + 3*sh.c*L*L;
+      if (!(slope > 0)) return false;
+      L -= (sh.a + sh.b*L + sh.c*L*L*L - y)/slope;
+    }
+
+    float adc = 1023.0*NTC_RESISTOR/(exp(L) + NTC_RESISTOR);
+    if (!isfinite(adc)) return false;
+    long scaled = lround(adc*64);
+    table->adc[i] = constrain(scaled, 0L, 1023L*64);
+    if (i > 0 && table->adc[i] < table->adc[i - 1]) return false;
+  }
+  return true;
+}
+
+static uint16_t tableX(int adc) {
+  return (uint16_t)constrain(adc, 0, 1023) << 6;
+}
+
+// A reading that saturates the table is an open or shorted sensor (or a part
+// hotter than the table), either way the lookup no longer tracks it
+bool tempTableInRange(const TempTable* table, int adc) {
+  uint16_t x = tableX(adc);
+  return x > table->adc[0] && x < table->adc[TEMP_TABLE_SIZE - 1];
+}
+
+fixed_t tempTableLookup(const TempTable* table, int adc) {
+  uint16_t x = tableX(adc);
+  if (x <= table->adc[0]) return INT_TO_FIXED(TEMP_TABLE_MIN_C);
+  if (x >= table->adc[TEMP_TABLE_SIZE - 1]) return INT_TO_FIXED(TEMP_TABLE_MAX_C);
+
+  uint8_t lo = 0, hi = TEMP_TABLE_SIZE - 1;        //adc[lo] <= x < adc[hi]
+  while (hi - lo > 1) {
+    uint8_t mid = (lo + hi)/2;
+    if (table->adc[mid] <= x) lo = mid;
+    else hi = mid;
+  }
+
+  long base = (long)(TEMP_TABLE_MIN_C + lo*TEMP_TABLE_STEP_C)*FIXED_ONE;
+  long offset = (long)(x - table->adc[lo])*TEMP_TABLE_STEP_C*FIXED_ONE/(table->adc[hi] - table->adc[lo]);
+  return fixedSaturate(base + offset);
+}
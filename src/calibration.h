@@ -0,0 +1,40 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Arduino.h>
+#include <config.h>
+#include <fixedpoint.h>
+
+#if CALIBRATION_POINTS < 3
+  #error "Steinhart-Hart needs at least 3 calibration points"
+#endif
+
+// 1/T = a + b*ln(R) + c*ln(R)^3, T in Kelvin, R in Ohm
+struct SteinhartHart {
+  float a;
+  float b;
+  float c;
+};
+
+struct CalibrationPoint {
+  uint16_t adc;
+  fixed_t temperature;      //reference reading (C)
+};
+
+// ADC readings (Q10.6) at TEMP_TABLE_MIN_C + i*TEMP_TABLE_STEP_C, rising with
+// temperature. Built once from the coefficients so a conversion is a binary
+// search and one interpolation instead of a log() per reading.
+struct TempTable {
+  uint16_t adc[TEMP_TABLE_SIZE];
+};
+
+void calibrationDefaults(SteinhartHart*);                   //beta model from config.h
+bool calibrationFit(const CalibrationPoint*, uint8_t count, SteinhartHart*);
+bool calibrationLoad(SteinhartHart*);                       //false if EEPROM holds no valid record
+void calibrationSave(const SteinhartHart&);
+
+bool tempTableBuild(TempTable*, const SteinhartHart&);      //false if the coefficients aren't monotonic
+fixed_t tempTableLookup(const TempTable*, int adc);         //clamped to TEMP_TABLE_MIN_C..TEMP_TABLE_MAX_C
+bool tempTableInRange(const TempTable*, int adc);           //false at or past either end of the table
+
+#endif
@@ -0,0 +1,28 @@
+#include <command.h>
+#include <sync.h>
+
+static Command commandQueue[COMMAND_QUEUE_SIZE];
+static sync_counter_t commandHead(0);      //written by the producer only
+static sync_counter_t commandTail(0);      //written by the consumer only
+
+bool commandPost(const Command& command) {
+  uint8_t head = commandHead;
+  uint8_t next = (head + 1) & (COMMAND_QUEUE_SIZE - 1);
+  if (next == commandTail) return false;
+
+  commandQueue[head] = command;
+  SYNC_BARRIER();
+  commandHead = next;
+  return true;
+}
+
+bool commandTake(Command* command) {
+  uint8_t tail = commandTail;
+  if (tail == commandHead) return false;
+
+  SYNC_BARRIER();
+  *command = commandQueue[tail];
+  SYNC_BARRIER();
+  commandTail = (tail + 1) & (COMMAND_QUEUE_SIZE - 1);
+  return true;
+}
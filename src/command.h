@@ -0,0 +1,27 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <Arduino.h>
+#include <fixedpoint.h>
+
+#define COMMAND_QUEUE_SIZE 8        //power of two
+
+enum CommandType : uint8_t {
+  CMD_TOGGLE_HEATER,
+  CMD_TOGGLE_MOTOR,
+  CMD_TOGGLE_FAN,
+  CMD_ADJUST,                       //add value to the MachineState field at offset (adjustable fields only, see control.cpp)
+  CMD_SWAP_TEMP_TABLE,              //switch conversion to the spare table (controlSpareTempTable)
+};
+
+struct Command {
+  CommandType type;
+  uint8_t offset;
+  fixed_t value;
+};
+
+// Single producer (UI) / single consumer (control core) mailbox
+bool commandPost(const Command&);   //false if the mailbox is full
+bool commandTake(Command*);         //false if the mailbox is empty
+
+#endif
@@ -24,7 +24,9 @@
 #define SCREEN_ADDRESS 0x27         //I2C address
 #define SCREEN_WIDTH  16
 #define SCREEN_HEIGHT 2
-#define SCREEN_REFRESH_MILLISECONDS 25
+#define SCREEN_REFRESH_MILLISECONDS 25        //while the encoder or buttons are in use
+#define SCREEN_IDLE_REFRESH_MILLISECONDS 250  //otherwise
+#define UI_ACTIVE_MILLISECONDS 3000           //how long input keeps the fast refresh going
 
 #define ENCODER_PIN_A 5
 #define ENCODER_PIN_B 6
@@ -33,15 +35,25 @@
 #define NTC_PIN A0                  //Analog pin
 #define NTC_VALUE 100000.0          //100k NTC
 #define NTC_RESISTOR 100000.0       //100k resistor
-#define NTC_BETA 3950.0             //3950 beta
+#define NTC_BETA 3950.0             //3950 beta, used until the sensor is calibrated
+
+#define CALIBRATION_POINTS 3        //reference points per calibration (3 or more), Steinhart-Hart fit
+#define CALIBRATION_EEPROM_ADDRESS 0
+#define CALIBRATION_SAMPLES 8       //NTC readings (one per update) averaged into each point, power of two
+#define TEMP_TABLE_MIN_C -20        //(C) range and node spacing of the ADC -> temperature table
+#define TEMP_TABLE_MAX_C 300
+#define TEMP_TABLE_STEP_C 5
 
 #define UPDATE_FREQ 4               //(Hz) check and recalculate everything at this frequency
+#define CONTROL_TICK_HZ 1000        //(Hz) timer interrupt rate of the control core (heater PWM, motor steps)
 #define TEMP_ERROR_MAX 10           //(C) sets at which point the power starts going down when nearing the target 
+#define IDLE_SLEEP                  //sleep the CPU between interrupts instead of spinning in loop()
 
 
 // -------------- System defines, do not change --------------
 #define REFERENCE_TEMP_CELSIUS 25.0         //25 degrees celsius
 #define REFERENCE_RESISTANCE 100000.0       //100k NTC
 #define REFERENCE_TEMP_KELVIN (273.15 + REFERENCE_TEMP_CELSIUS)
+#define TEMP_TABLE_SIZE ((TEMP_TABLE_MAX_C - TEMP_TABLE_MIN_C) / TEMP_TABLE_STEP_C + 1)
 
 #endif
\ No newline at end of file
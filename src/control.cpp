@@ -0,0 +1,204 @@
+#include <Arduino.h>
+#include <config.h>
+#include <control.h>
+#include <command.h>
+#include <state.h>
+#include <sync.h>
+#include <adc.h>
+
+#ifndef __AVR__
+  #include <NativeSim.h>
+#endif
+
+#define TICKS_PER_UPDATE (CONTROL_TICK_HZ / UPDATE_FREQ)
+
+#if TICKS_PER_UPDATE < 1
+  #error "CONTROL_TICK_HZ must be at least UPDATE_FREQ"
+#endif
+
+#if CONTROL_TICK_HZ > (FIXED_MAX >> FIXED_FRAC_BITS)
+  #error "fixed_t can't hold speeds up to CONTROL_TICK_HZ"
+#endif
+
+static MachineState core = {
+  {0, 0},                   //temperature: current, set
+  {0, 0},                   //speed: current, set
+  INT_TO_FIXED(25),         //calibrationReference
+  0,                        //ntcRaw
+  0,                        //ntcAverage
+  0,                        //tickLateMax_us
+  false, false, false,      //heater, motor, fan
+  false,                    //heaterOutput
+  false                     //sensorFault
+};
+
+// The only fields CMD_ADJUST may change, with their limits. Index 0 of
+// temperature and speed is measured/driven by the core and never adjustable.
+// The setpoint stays TEMP_ERROR_MAX below the top of the table so the heater
+// is throttled before readings saturate.
+struct AdjustableField {
+  uint8_t offset;
+  fixed_t min;
+  fixed_t max;
+};
+static const AdjustableField adjustableFields[] = {
+  {offsetof(MachineState, temperature[1]), INT_TO_FIXED(0), INT_TO_FIXED(TEMP_TABLE_MAX_C - TEMP_ERROR_MAX)},
+  {offsetof(MachineState, speed[1]), INT_TO_FIXED(-CONTROL_TICK_HZ), INT_TO_FIXED(CONTROL_TICK_HZ)},
+  {offsetof(MachineState, calibrationReference), INT_TO_FIXED(TEMP_TABLE_MIN_C), INT_TO_FIXED(TEMP_TABLE_MAX_C)}
+};
+
+#if CALIBRATION_SAMPLES > 64 || (CALIBRATION_SAMPLES & (CALIBRATION_SAMPLES - 1))
+  #error "CALIBRATION_SAMPLES must be a power of two up to 64 (16 bit sum)"
+#endif
+
+static int heatPower = 0;
+static unsigned int updateCountdown = 0;
+static unsigned long stepCountdown = 0;
+static int step = false;
+
+static uint16_t ntcHistory[CALIBRATION_SAMPLES];
+static uint16_t ntcSum = 0;
+static uint8_t ntcHistoryIndex = 0;
+static bool ntcHistoryFilled = false;
+
+// Double buffered so the UI can build a new table after a calibration while the core keeps converting
+static TempTable tempTables[2];
+static sync_counter_t activeTempTable(0);
+
+
+#ifdef __AVR__
+ISR(TIMER1_COMPA_vect) {
+  uint16_t late_us = TCNT1 * (64000000UL / F_CPU);      //CTC: timer counts since the compare match
+  if (late_us > core.tickLateMax_us) core.tickLateMax_us = late_us;
+  controlTick();
+}
+#endif
+
+void controlStart() {
+  SteinhartHart coefficients;
+  if (!calibrationLoad(&coefficients) || !tempTableBuild(&tempTables[activeTempTable], coefficients)) {
+    calibrationDefaults(&coefficients);
+    tempTableBuild(&tempTables[activeTempTable], coefficients);
+  }
+  statePublish(&core);
+  adcStart(NTC_PIN);        //for the first update()
+
+  #ifdef __AVR__
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);     //CTC, clk/64
+  TCNT1 = 0;
+  OCR1A = F_CPU / 64 / CONTROL_TICK_HZ - 1;
+  TIMSK1 = _BV(OCIE1A);
+  interrupts();
+  #else
+  simAttachTimerInterrupt(controlTick, 1000000UL / CONTROL_TICK_HZ);
+  #endif
+}
+
+static void applyCommand(const Command& command) {
+  switch (command.type) {
+    case CMD_TOGGLE_HEATER: core.heaterOn = !core.heaterOn; break;
+    case CMD_TOGGLE_MOTOR: core.motorOn = !core.motorOn; break;
+    case CMD_TOGGLE_FAN: core.fanOn = !core.fanOn; break;
+    case CMD_ADJUST:
+      for (uint8_t i = 0; i < sizeof(adjustableFields)/sizeof(adjustableFields[0]); i++) {
+        const AdjustableField& allowed = adjustableFields[i];
+        if (command.offset != allowed.offset) continue;
+        fixed_t* field = STATE_FIELD(&core, command.offset);
+        *field = constrain((long)*field + command.value, (long)allowed.min, (long)allowed.max);
+        break;
+      }
+      break;
+    case CMD_SWAP_TEMP_TABLE: activeTempTable = activeTempTable ^ 1; break;
+  }
+}
+
+void controlTick() {
+  Command command;
+  while (commandTake(&command)) applyCommand(command);
+
+  if (updateCountdown == 0) {
+    update();
+    updateCountdown = TICKS_PER_UPDATE;
+  }
+  updateCountdown--;
+  if (updateCountdown == 0) adcStart(NTC_PIN);     //converts while waiting for the next tick's update()
+
+  if (core.heaterOn && !core.sensorFault) setHeatPower(heatPower);
+  else setHeatPower(0);
+
+  if (core.motorOn && core.speed[1] != 0) {
+    if (stepCountdown == 0) {
+      step = !step;
+      if (core.speed[0] >= 0) digitalWrite(MOTOR_DIR_PIN, !INVERT_MOTOR_DIRECTION);
+      else digitalWrite(MOTOR_DIR_PIN, INVERT_MOTOR_DIRECTION);
+      digitalWrite(MOTOR_STEP_PIN, step);
+      stepCountdown = ((long)CONTROL_TICK_HZ << FIXED_FRAC_BITS) / abs(core.speed[1]);
+    }
+    if (stepCountdown > 0) stepCountdown--;
+  }
+  else stepCountdown = 0;
+
+  statePublish(&core);
+}
+
+void update(){
+  core.ntcRaw = adcResult();
+  if (!ntcHistoryFilled) {
+    for (uint8_t i = 0; i < CALIBRATION_SAMPLES; i++) ntcHistory[i] = core.ntcRaw;
+    ntcSum = core.ntcRaw * CALIBRATION_SAMPLES;
+    ntcHistoryFilled = true;
+  }
+  ntcSum += core.ntcRaw - ntcHistory[ntcHistoryIndex];
+  ntcHistory[ntcHistoryIndex] = core.ntcRaw;
+  ntcHistoryIndex = (ntcHistoryIndex + 1) & (CALIBRATION_SAMPLES - 1);
+  core.ntcAverage = (ntcSum + CALIBRATION_SAMPLES / 2) / CALIBRATION_SAMPLES;
+  core.temperature[0] = tempFromAnalog(core.ntcRaw);
+  core.sensorFault = !tempTableInRange(&tempTables[activeTempTable], core.ntcRaw);
+  long tempError = (long)core.temperature[0] - core.temperature[1];
+  heatPower = constrain(-tempError*100/((long)TEMP_ERROR_MAX*FIXED_ONE), -100, 100);
+
+  long speedError = (long)core.speed[0] - core.speed[1];
+  const fixed_t accelAddition = (fixed_t)((long)MOTOR_ACCELERATION*UPDATE_FREQ*FIXED_ONE/1000);
+  if(speedError > accelAddition) core.speed[0] = fixedSaturate((long)core.speed[0] + accelAddition);
+  else core.speed[0] = core.speed[1];
+
+  digitalWrite(FAN_PIN, core.fanOn);
+
+  return;
+}
+
+fixed_t tempFromAnalog (int val) {
+  return tempTableLookup(&tempTables[activeTempTable], val);
+}
+
+TempTable* controlSpareTempTable() {
+  return &tempTables[activeTempTable ^ 1];
+}
+
+// Called every tick; with HEATER_SWITCH_FREQ the heater is switched in windows of 1/HEATER_SWITCH_FREQ s
+void setHeatPower(int percentage) {
+  if (percentage < 0) percentage = 0;
+  if (percentage > 100) percentage = 100;
+  
+  #ifndef HEATER_SWITCH_FREQ
+  static int lastPercentage = -1;
+  if (percentage != lastPercentage) {
+    analogWrite(HEATER_PIN, percentage * 255 / 100);
+    lastPercentage = percentage;
+    core.heaterOutput = percentage > 0;
+  }
+  #else
+
+  const unsigned long windowTicks = CONTROL_TICK_HZ / HEATER_SWITCH_FREQ;
+  static unsigned long windowTick = 0;
+  uint8_t on = windowTick < windowTicks * percentage / 100;
+  if (on != core.heaterOutput) {
+    core.heaterOutput = on;
+    digitalWrite(HEATER_PIN, on);
+  }
+  if (++windowTick >= windowTicks) windowTick = 0;
+
+  #endif
+}
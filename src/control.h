@@ -0,0 +1,18 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <fixedpoint.h>
+#include <calibration.h>
+
+// Real-time control core: heater, motor and fan decisions run from a timer
+// interrupt at CONTROL_TICK_HZ, independent of how long the UI loop takes.
+void controlStart();
+void controlTick();
+
+void update();
+void setHeatPower(int);
+fixed_t tempFromAnalog(int);
+
+TempTable* controlSpareTempTable();     //UI: fill, then post CMD_SWAP_TEMP_TABLE
+
+#endif
@@ -0,0 +1,23 @@
+#include <fixedpoint.h>
+
+size_t printFixed(Print& out, fixed_t value, uint8_t decimals) {
+  size_t n = 0;
+  long magnitude = value < 0 ? -(long)value : value;
+
+  long scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+  long scaled = (magnitude * scale + FIXED_ONE / 2) >> FIXED_FRAC_BITS;
+  if (value < 0 && scaled != 0) n += out.print('-');
+
+  n += out.print(scaled / scale);
+  if (decimals == 0) return n;
+
+  n += out.print('.');
+  long fraction = scaled % scale;
+  while (scale > 1) {
+    scale /= 10;
+    n += out.print((char)('0' + fraction / scale));
+    fraction %= scale;
+  }
+  return n;
+}
@@ -0,0 +1,37 @@
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <Arduino.h>
+
+// Signed Q10.5: 1/32 resolution, range +-1023.97. Covers temperatures in C and
+// motor speeds up to the control tick rate (CONTROL_TICK_HZ) in steps/s
+// without pulling in the software float library.
+typedef int16_t fixed_t;
+
+#define FIXED_FRAC_BITS 5
+#define FIXED_ONE (1 << FIXED_FRAC_BITS)
+#define FIXED_MAX 0x7FFF              //not INT16_MAX, avr-libc hides it from C++ without __STDC_LIMIT_MACROS
+#define FIXED_MIN (-FIXED_MAX - 1)
+
+#define INT_TO_FIXED(i) ((fixed_t)((i) * FIXED_ONE))
+#define FIXED_TO_INT(x) ((x) / FIXED_ONE)                 //truncates towards zero like (int)float
+#define FIXED_TO_FLOAT(x) ((float)(x) / FIXED_ONE)
+
+inline fixed_t fixedSaturate(long value) {
+  if (value > FIXED_MAX) return FIXED_MAX;
+  if (value < FIXED_MIN) return FIXED_MIN;
+  return (fixed_t)value;
+}
+
+inline fixed_t fixedFromFloat(float value) {
+  if (!(value == value)) return 0;                          //NaN
+  value *= FIXED_ONE;
+  if (value >= FIXED_MAX) return FIXED_MAX;
+  if (value <= FIXED_MIN) return FIXED_MIN;
+  return (fixed_t)(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+// Prints value with the given number of (rounded) decimals using integer math only
+size_t printFixed(Print& out, fixed_t value, uint8_t decimals);
+
+#endif
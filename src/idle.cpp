@@ -0,0 +1,59 @@
+#include <Arduino.h>
+#include <config.h>
+#include <idle.h>
+
+#ifdef __AVR__
+  #include <avr/sleep.h>
+
+// Wakes the CPU, inputHandler() polls the pins afterwards. The flag covers an
+// edge that arrives after the pins were polled but before idleSleep(): the
+// interrupt has already run by then, so sleeping would wait for the next one.
+// All inputs in config.h are on port D (PCINT2); an input on another port is
+// not enabled and is still picked up within a millisecond by the timer wake-ups.
+static volatile bool inputChanged = false;
+ISR(PCINT2_vect) {
+  inputChanged = true;
+}
+
+static void wakeOnPinChange(uint8_t pin) {
+  if (digitalPinToPCICRbit(pin) != PCIE2) return;
+  *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+  PCICR |= bit(PCIE2);
+}
+#else
+  #include <NativeSim.h>
+#endif
+
+void idleSetup() {
+  #ifdef __AVR__
+  wakeOnPinChange(ENCODER_PIN_A);
+  wakeOnPinChange(ENCODER_PIN_B);
+  wakeOnPinChange(ENCODER_BUTTON_PIN);
+  wakeOnPinChange(BUTTON_0_PIN);
+  wakeOnPinChange(BUTTON_1_PIN);
+  wakeOnPinChange(BUTTON_2_PIN);
+  set_sleep_mode(SLEEP_MODE_IDLE);      //timers, TWI, UART and ADC keep running
+  #endif
+}
+
+void idleInputPolled() {
+  #ifdef __AVR__
+  inputChanged = false;
+  #endif
+}
+
+void idleSleep() {
+  #ifdef __AVR__
+  noInterrupts();
+  if (inputChanged) {   //changed while the loop ran, poll again instead of sleeping
+    interrupts();
+    return;
+  }
+  sleep_enable();
+  interrupts();         //the instruction after sei always runs, so an edge from here on wakes sleep_cpu
+  sleep_cpu();
+  sleep_disable();
+  #else
+  simSleepUntilInterrupt();
+  #endif
+}
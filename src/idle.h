@@ -0,0 +1,11 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+// CPU sleep for the UI loop. Everything that has to happen on time runs from
+// interrupts (control core, millis), the encoder and button pins get pin
+// change interrupts so input wakes the loop immediately.
+void idleSetup();
+void idleInputPolled();  //call right before reading the input pins
+void idleSleep();       //returns after the next interrupt, or at once if an input changed since idleInputPolled()
+
+#endif
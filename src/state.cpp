@@ -0,0 +1,27 @@
+#include <state.h>
+#include <sync.h>
+#include <string.h>
+
+// Seqlock: the sequence is odd while the producer is writing, readers retry
+// until they copied the data between two identical even sequence values.
+static sync_counter_t stateSequence(0);
+static MachineState publishedState;
+
+void statePublish(const MachineState* source) {
+  stateSequence = stateSequence + 1;
+  SYNC_BARRIER();
+  memcpy(&publishedState, source, sizeof(MachineState));
+  SYNC_BARRIER();
+  stateSequence = stateSequence + 1;
+}
+
+void stateSnapshot(MachineState* out) {
+  uint8_t before, after;
+  do {
+    before = stateSequence;
+    SYNC_BARRIER();
+    memcpy(out, &publishedState, sizeof(MachineState));
+    SYNC_BARRIER();
+    after = stateSequence;
+  } while ((before & 1) || before != after);
+}
@@ -0,0 +1,31 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <fixedpoint.h>
+
+// Machine state owned by the control core. The UI only ever sees published
+// copies (stateSnapshot) and changes it by posting commands (command.h).
+struct MachineState {
+  fixed_t temperature[2];   //current, set (C)
+  fixed_t speed[2];         //current, set (steps/s)
+  fixed_t calibrationReference;   //reference temperature entered while calibrating (C)
+  uint16_t ntcRaw;          //last NTC ADC reading
+  uint16_t ntcAverage;      //mean of the last CALIBRATION_SAMPLES readings
+  uint16_t tickLateMax_us;  //worst control tick start after its deadline (AVR only)
+
+  uint8_t heaterOn;         //enabled by the user
+  uint8_t motorOn;
+  uint8_t fanOn;
+  uint8_t heaterOutput;     //current level of HEATER_PIN
+  uint8_t sensorFault;      //NTC reading outside the temperature table, heater forced off
+};
+
+// Fields are addressed by offset so menu bindings and commands work on any MachineState copy
+#define STATE_FIELD(statePtr, offset) ((fixed_t*)((uint8_t*)(statePtr) + (offset)))
+
+void statePublish(const MachineState*);     //control core only (single producer)
+void stateSnapshot(MachineState*);          //any context, never blocks the producer
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <stdint.h>
+
+// Primitives for handing data between the control core (timer ISR on the
+// Uno, its own thread on native) and the UI loop without locks.
+#ifdef __AVR__
+  // Byte accesses are atomic and the ISR can't be preempted by the loop, a
+  // compiler barrier is all that is needed.
+  typedef volatile uint8_t sync_counter_t;
+  #define SYNC_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+  #include <atomic>
+  typedef std::atomic<uint8_t> sync_counter_t;
+  #define SYNC_BARRIER() std::atomic_thread_fence(std::memory_order_seq_cst)
+#endif
+
+#endif
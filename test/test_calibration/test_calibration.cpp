@@ -0,0 +1,165 @@
+// Sensor calibration: Steinhart-Hart fit, ADC -> temperature table and the
+// EEPROM record (lib/NativeArduino keeps EEPROM in RAM, erased at start).
+
+#include <math.h>
+#include <stddef.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <config.h>
+#include <calibration.h>
+
+// Published coefficients of a common 100k / 3950 NTC
+static const SteinhartHart known = {0.7203283552e-3, 2.171656865e-4, 0.8706070062e-7};
+
+static double modelTemperature(const SteinhartHart& sh, int adc) {
+  double L = log(NTC_RESISTOR * (1023.0 - adc) / adc);
+  return 1.0 / (sh.a + sh.b * L + sh.c * L * L * L) - 273.15;
+}
+
+static double betaTemperature(int adc) {
+  double R = NTC_RESISTOR * (1023.0 - adc) / adc;
+  return 1.0 / (1.0 / REFERENCE_TEMP_KELVIN + log(R / NTC_VALUE) / NTC_BETA) - 273.15;
+}
+
+static void assertIncreasing(const TempTable& table) {
+  for (uint8_t i = 1; i < TEMP_TABLE_SIZE; i++) TEST_ASSERT_TRUE(table.adc[i] > table.adc[i - 1]);
+}
+
+void setUp() {
+  for (int i = 0; i < EEPROM.length(); i++) EEPROM.write(i, 0xFF);
+}
+
+void tearDown() {}
+
+void test_fit_recovers_known_coefficients() {
+  const int adcs[CALIBRATION_POINTS] = {330, 920, 1010};      //about 10, 100 and 190 C
+  CalibrationPoint points[CALIBRATION_POINTS];
+  for (uint8_t i = 0; i < CALIBRATION_POINTS; i++) {
+    points[i].adc = adcs[i];
+    points[i].temperature = fixedFromFloat(modelTemperature(known, adcs[i]));
+  }
+
+  SteinhartHart fitted;
+  TEST_ASSERT_TRUE(calibrationFit(points, CALIBRATION_POINTS, &fitted));
+  TEST_ASSERT_FLOAT_WITHIN(0.02 * known.b, known.b, fitted.b);
+
+  // The references are rounded to 1/FIXED_ONE C, compare what matters: the temperatures
+  for (int adc = 300; adc <= 1015; adc += 5) {
+    TEST_ASSERT_FLOAT_WITHIN(0.1, modelTemperature(known, adc), modelTemperature(fitted, adc));
+  }
+}
+
+void test_fit_rejects_bad_points() {
+  SteinhartHart out;
+  CalibrationPoint points[CALIBRATION_POINTS] = {
+    {330, INT_TO_FIXED(10)}, {920, INT_TO_FIXED(100)}, {1010, INT_TO_FIXED(190)}
+  };
+  TEST_ASSERT_TRUE(calibrationFit(points, CALIBRATION_POINTS, &out));
+  TEST_ASSERT_FALSE(calibrationFit(points, 2, &out));
+
+  CalibrationPoint same[CALIBRATION_POINTS] = {
+    {500, INT_TO_FIXED(30)}, {500, INT_TO_FIXED(30)}, {500, INT_TO_FIXED(30)}
+  };
+  TEST_ASSERT_FALSE(calibrationFit(same, CALIBRATION_POINTS, &out));
+
+  CalibrationPoint saturated[CALIBRATION_POINTS] = {
+    {0, INT_TO_FIXED(10)}, {920, INT_TO_FIXED(100)}, {1023, INT_TO_FIXED(190)}
+  };
+  TEST_ASSERT_FALSE(calibrationFit(saturated, CALIBRATION_POINTS, &out));
+
+  // Temperature falling as the ADC rises gives b <= 0
+  CalibrationPoint reversed[CALIBRATION_POINTS] = {
+    {330, INT_TO_FIXED(190)}, {920, INT_TO_FIXED(100)}, {1010, INT_TO_FIXED(10)}
+  };
+  TEST_ASSERT_FALSE(calibrationFit(reversed, CALIBRATION_POINTS, &out));
+}
+
+void test_table_monotonic() {
+  TempTable table;
+  SteinhartHart beta;
+  calibrationDefaults(&beta);
+  TEST_ASSERT_TRUE(tempTableBuild(&table, beta));
+  assertIncreasing(table);
+
+  TEST_ASSERT_TRUE(tempTableBuild(&table, known));
+  assertIncreasing(table);
+}
+
+void test_table_rejects_bad_coefficients() {
+  TempTable table;
+  SteinhartHart negativeSlope = {known.a, -known.b, known.c};
+  TEST_ASSERT_FALSE(tempTableBuild(&table, negativeSlope));
+
+  SteinhartHart foldingBack = {known.a, known.b, -1e-4f};     //b + 3c*ln(R)^2 turns negative in range
+  TEST_ASSERT_FALSE(tempTableBuild(&table, foldingBack));
+
+  SteinhartHart notANumber = {NAN, known.b, known.c};
+  TEST_ASSERT_FALSE(tempTableBuild(&table, notANumber));
+}
+
+void test_lookup_matches_beta_model() {
+  TempTable table;
+  SteinhartHart beta;
+  calibrationDefaults(&beta);
+  TEST_ASSERT_TRUE(tempTableBuild(&table, beta));
+
+  // Interpolation error grows where the curve bends hardest, below room temperature
+  float worst = 0, worstAboveRoom = 0;
+  for (int adc = 1; adc < 1023; adc++) {
+    if (!tempTableInRange(&table, adc)) continue;
+    float error = fabs(FIXED_TO_FLOAT(tempTableLookup(&table, adc)) - betaTemperature(adc));
+    if (error > worst) worst = error;
+    if (betaTemperature(adc) >= 20 && error > worstAboveRoom) worstAboveRoom = error;
+  }
+  TEST_ASSERT_LESS_THAN_FLOAT(0.15, worstAboveRoom);
+  TEST_ASSERT_LESS_THAN_FLOAT(0.2, worst);
+}
+
+void test_lookup_saturation() {
+  TempTable table;
+  SteinhartHart beta;
+  calibrationDefaults(&beta);
+  TEST_ASSERT_TRUE(tempTableBuild(&table, beta));
+
+  TEST_ASSERT_FALSE(tempTableInRange(&table, 0));
+  TEST_ASSERT_FALSE(tempTableInRange(&table, 1023));
+  TEST_ASSERT_TRUE(tempTableInRange(&table, 512));
+  TEST_ASSERT_EQUAL_INT16(INT_TO_FIXED(TEMP_TABLE_MIN_C), tempTableLookup(&table, 0));
+  TEST_ASSERT_EQUAL_INT16(INT_TO_FIXED(TEMP_TABLE_MAX_C), tempTableLookup(&table, 1023));
+}
+
+void test_eeprom_round_trip() {
+  SteinhartHart loaded;
+  TEST_ASSERT_FALSE(calibrationLoad(&loaded));      //erased EEPROM
+
+  calibrationSave(known);
+  TEST_ASSERT_TRUE(calibrationLoad(&loaded));
+  TEST_ASSERT_TRUE(loaded.a == known.a && loaded.b == known.b && loaded.c == known.c);
+}
+
+void test_eeprom_rejects_corruption() {
+  calibrationSave(known);
+  SteinhartHart loaded;
+  struct Record { uint16_t magic; SteinhartHart coefficients; uint8_t checksum; };    //layout of the stored record
+  for (uint8_t i = 0; i <= offsetof(Record, checksum); i++) {
+    uint8_t byte = EEPROM.read(CALIBRATION_EEPROM_ADDRESS + i);
+    EEPROM.write(CALIBRATION_EEPROM_ADDRESS + i, byte ^ 0x10);
+    TEST_ASSERT_FALSE(calibrationLoad(&loaded));
+    EEPROM.write(CALIBRATION_EEPROM_ADDRESS + i, byte);
+  }
+  TEST_ASSERT_TRUE(calibrationLoad(&loaded));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fit_recovers_known_coefficients);
+  RUN_TEST(test_fit_rejects_bad_points);
+  RUN_TEST(test_table_monotonic);
+  RUN_TEST(test_table_rejects_bad_coefficients);
+  RUN_TEST(test_lookup_matches_beta_model);
+  RUN_TEST(test_lookup_saturation);
+  RUN_TEST(test_eeprom_round_trip);
+  RUN_TEST(test_eeprom_rejects_corruption);
+  return UNITY_END();
+}
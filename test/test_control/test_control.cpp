@@ -0,0 +1,214 @@
+// Control core: heater PWM windows, motor step countdown and the safety
+// limits. The core runs from the emulated timer interrupt in simulated time,
+// so every simAdvanceMicros() of one tick period runs exactly one controlTick().
+
+#include <unity.h>
+#include <Arduino.h>
+#include <NativeSim.h>
+#include <config.h>
+#include <state.h>
+#include <command.h>
+#include <control.h>
+
+#define TICK_US (1000000UL / CONTROL_TICK_HZ)
+
+static void runTicks(unsigned long ticks) {
+  simAdvanceMicros(ticks * TICK_US);
+}
+
+static MachineState snapshot() {
+  MachineState s;
+  stateSnapshot(&s);
+  return s;
+}
+
+static void post(const Command& command) {
+  TEST_ASSERT_TRUE(commandPost(command));
+  runTicks(1);        //drained at the start of the next tick
+}
+
+static void setToggle(CommandType type, uint8_t MachineState::*flag, bool on) {
+  if ((snapshot().*flag != 0) != on) post({type, 0, 0});
+  TEST_ASSERT_EQUAL_UINT8(on, snapshot().*flag);
+}
+
+static void setField(uint8_t offset, fixed_t value) {
+  MachineState s = snapshot();
+  post({CMD_ADJUST, offset, (fixed_t)(value - *STATE_FIELD(&s, offset))});
+}
+
+// Waits for the next update() so heatPower follows the latest setpoint
+static void settle() {
+  runTicks(CONTROL_TICK_HZ / UPDATE_FREQ);
+}
+
+void setUp() {
+  simSetAnalog(NTC_PIN, 512);       //room temperature
+  setToggle(CMD_TOGGLE_HEATER, &MachineState::heaterOn, false);
+  setToggle(CMD_TOGGLE_MOTOR, &MachineState::motorOn, false);
+  setToggle(CMD_TOGGLE_FAN, &MachineState::fanOn, false);
+  settle();
+}
+
+void tearDown() {}
+
+// Heater duty over one switching window (1/HEATER_SWITCH_FREQ s) for a setpoint offset from the current temperature
+static float heaterDuty(fixed_t aboveCurrent) {
+  setField(offsetof(MachineState, temperature[1]), snapshot().temperature[0] + aboveCurrent);
+  setToggle(CMD_TOGGLE_HEATER, &MachineState::heaterOn, true);
+  settle();
+
+  const unsigned long windowTicks = CONTROL_TICK_HZ / HEATER_SWITCH_FREQ;
+  uint64_t high_us = simPinHighMicros(HEATER_PIN);
+  runTicks(windowTicks);
+  return (float)(simPinHighMicros(HEATER_PIN) - high_us) / (windowTicks * TICK_US);
+}
+
+void test_heater_duty_proportional() {
+  // Power falls off linearly within TEMP_ERROR_MAX of the setpoint
+  TEST_ASSERT_FLOAT_WITHIN(0.002, 0.5, heaterDuty(INT_TO_FIXED(TEMP_ERROR_MAX) / 2));
+  TEST_ASSERT_FLOAT_WITHIN(0.002, 0.25, heaterDuty(INT_TO_FIXED(TEMP_ERROR_MAX) / 4));
+}
+
+void test_heater_duty_limits() {
+  TEST_ASSERT_FLOAT_WITHIN(0.002, 1.0, heaterDuty(INT_TO_FIXED(2 * TEMP_ERROR_MAX)));
+  TEST_ASSERT_FLOAT_WITHIN(0.002, 0.0, heaterDuty(-INT_TO_FIXED(1)));
+}
+
+void test_heater_off_when_disabled() {
+  heaterDuty(INT_TO_FIXED(2 * TEMP_ERROR_MAX));
+  setToggle(CMD_TOGGLE_HEATER, &MachineState::heaterOn, false);
+  TEST_ASSERT_EQUAL(LOW, simPinLevel(HEATER_PIN));
+
+  uint64_t high_us = simPinHighMicros(HEATER_PIN);
+  runTicks(CONTROL_TICK_HZ / HEATER_SWITCH_FREQ);
+  TEST_ASSERT_TRUE(simPinHighMicros(HEATER_PIN) == high_us);
+}
+
+// STEP pin toggles in one second at the given setpoint
+static unsigned long stepToggles(int stepsPerSecond) {
+  setField(offsetof(MachineState, speed[1]), INT_TO_FIXED(stepsPerSecond));
+  setToggle(CMD_TOGGLE_MOTOR, &MachineState::motorOn, true);
+  runTicks(CONTROL_TICK_HZ);
+
+  unsigned long writes = simPinWrites(MOTOR_STEP_PIN);
+  runTicks(CONTROL_TICK_HZ);
+  return simPinWrites(MOTOR_STEP_PIN) - writes;
+}
+
+void test_step_countdown() {
+  TEST_ASSERT_EQUAL_UINT32(100, stepToggles(100));
+  TEST_ASSERT_EQUAL_UINT32(250, stepToggles(250));
+  TEST_ASSERT_EQUAL_UINT32(100, stepToggles(-100));
+  TEST_ASSERT_EQUAL_UINT32(CONTROL_TICK_HZ, stepToggles(CONTROL_TICK_HZ));    //one toggle per tick
+}
+
+void test_step_stops() {
+  stepToggles(100);
+  setToggle(CMD_TOGGLE_MOTOR, &MachineState::motorOn, false);
+  unsigned long writes = simPinWrites(MOTOR_STEP_PIN);
+  runTicks(CONTROL_TICK_HZ);
+  TEST_ASSERT_EQUAL_UINT32(writes, simPinWrites(MOTOR_STEP_PIN));
+
+  TEST_ASSERT_EQUAL_UINT32(0, stepToggles(0));
+}
+
+void test_adjust_limits() {
+  setField(offsetof(MachineState, speed[1]), 0);
+  post({CMD_ADJUST, offsetof(MachineState, speed[1]), INT_TO_FIXED(CONTROL_TICK_HZ + 1)});
+  TEST_ASSERT_EQUAL_INT16(INT_TO_FIXED(CONTROL_TICK_HZ), snapshot().speed[1]);
+
+  // Measured and driven values are not adjustable, nor is anything that isn't a fixed_t field
+  MachineState before = snapshot();
+  post({CMD_ADJUST, offsetof(MachineState, temperature[0]), INT_TO_FIXED(50)});
+  post({CMD_ADJUST, offsetof(MachineState, speed[0]), INT_TO_FIXED(50)});
+  post({CMD_ADJUST, offsetof(MachineState, ntcRaw), INT_TO_FIXED(50)});
+  post({CMD_ADJUST, offsetof(MachineState, speed[1]) + 1, INT_TO_FIXED(1)});
+  post({CMD_ADJUST, 0xFF, INT_TO_FIXED(1)});
+  MachineState after = snapshot();
+  TEST_ASSERT_EQUAL_INT16(before.temperature[0], after.temperature[0]);
+  TEST_ASSERT_EQUAL_UINT16(before.ntcRaw, after.ntcRaw);
+  TEST_ASSERT_EQUAL_INT16(before.speed[1], after.speed[1]);
+}
+
+void test_heater_off_on_sensor_fault() {
+  TEST_ASSERT_FLOAT_WITHIN(0.002, 1.0, heaterDuty(INT_TO_FIXED(2 * TEMP_ERROR_MAX)));
+
+  const int saturated[] = {0, 1023};      //shorted / open divider
+  for (int adc : saturated) {
+    simSetAnalog(NTC_PIN, adc);
+    settle();
+    TEST_ASSERT_EQUAL_UINT8(true, snapshot().sensorFault);
+    TEST_ASSERT_EQUAL(LOW, simPinLevel(HEATER_PIN));
+
+    uint64_t high_us = simPinHighMicros(HEATER_PIN);
+    runTicks(CONTROL_TICK_HZ / HEATER_SWITCH_FREQ);
+    TEST_ASSERT_TRUE(simPinHighMicros(HEATER_PIN) == high_us);
+  }
+
+  simSetAnalog(NTC_PIN, 512);
+  settle();
+  TEST_ASSERT_EQUAL_UINT8(false, snapshot().sensorFault);
+  uint64_t high_us = simPinHighMicros(HEATER_PIN);
+  runTicks(CONTROL_TICK_HZ / HEATER_SWITCH_FREQ);
+  TEST_ASSERT_TRUE(simPinHighMicros(HEATER_PIN) > high_us);
+}
+
+void test_setpoint_limit() {
+  setField(offsetof(MachineState, temperature[1]), INT_TO_FIXED(100));
+  post({CMD_ADJUST, offsetof(MachineState, temperature[1]), INT_TO_FIXED(500)});
+  TEST_ASSERT_EQUAL_INT16(INT_TO_FIXED(TEMP_TABLE_MAX_C - TEMP_ERROR_MAX), snapshot().temperature[1]);
+  post({CMD_ADJUST, offsetof(MachineState, temperature[1]), -INT_TO_FIXED(500)});
+  TEST_ASSERT_EQUAL_INT16(0, snapshot().temperature[1]);
+}
+
+// update() collects the conversion started on the tick before instead of waiting for one
+void test_adc_sampled_tick_before_update() {
+  unsigned long reads = simAnalogReads(NTC_PIN);
+  while (simAnalogReads(NTC_PIN) == reads) runTicks(1);     //tick that ran update()
+
+  runTicks(CONTROL_TICK_HZ / UPDATE_FREQ - 2);
+  simSetAnalog(NTC_PIN, 600);
+  runTicks(1);                      //starts the conversion
+  simSetAnalog(NTC_PIN, 700);
+  reads = simAnalogReads(NTC_PIN);
+  runTicks(1);                      //update()
+  TEST_ASSERT_EQUAL_UINT32(reads + 1, simAnalogReads(NTC_PIN));
+  TEST_ASSERT_EQUAL_UINT16(600, snapshot().ntcRaw);
+
+  runTicks(CONTROL_TICK_HZ / UPDATE_FREQ);
+  TEST_ASSERT_EQUAL_UINT16(700, snapshot().ntcRaw);
+}
+
+// Calibration points use the mean of the last CALIBRATION_SAMPLES readings
+void test_ntc_average() {
+  runTicks(CALIBRATION_SAMPLES * CONTROL_TICK_HZ / UPDATE_FREQ);
+  TEST_ASSERT_EQUAL_UINT16(512, snapshot().ntcAverage);
+
+  simSetAnalog(NTC_PIN, 512 + 4 * CALIBRATION_SAMPLES);
+  for (int i = 0; i < 2 * CONTROL_TICK_HZ / UPDATE_FREQ && snapshot().ntcRaw == 512; i++) runTicks(1);
+  TEST_ASSERT_EQUAL_UINT16(512 + 4, snapshot().ntcAverage);     //first new reading
+
+  runTicks(CALIBRATION_SAMPLES * CONTROL_TICK_HZ / UPDATE_FREQ);
+  TEST_ASSERT_EQUAL_UINT16(512 + 4 * CALIBRATION_SAMPLES, snapshot().ntcAverage);
+}
+
+int main() {
+  simReset();
+  simSetAnalog(NTC_PIN, 512);       //room temperature
+  controlStart();
+  runTicks(1);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_heater_duty_proportional);
+  RUN_TEST(test_heater_duty_limits);
+  RUN_TEST(test_heater_off_when_disabled);
+  RUN_TEST(test_step_countdown);
+  RUN_TEST(test_step_stops);
+  RUN_TEST(test_adjust_limits);
+  RUN_TEST(test_heater_off_on_sensor_fault);
+  RUN_TEST(test_setpoint_limit);
+  RUN_TEST(test_adc_sampled_tick_before_update);
+  RUN_TEST(test_ntc_average);
+  return UNITY_END();
+}
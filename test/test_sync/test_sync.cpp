@@ -0,0 +1,169 @@
+// Seqlock (state.cpp) and command mailbox (command.cpp) between the UI and the
+// control core. The core runs on the NativeArduino real-time timer thread
+// here, like it does under env:bench.
+
+#include <atomic>
+#include <string.h>
+#include <unity.h>
+#include <Arduino.h>
+#include <NativeSim.h>
+#include <config.h>
+#include <state.h>
+#include <command.h>
+
+void setUp() {
+  simReset();
+  Command command;
+  while (commandTake(&command));
+}
+
+void tearDown() {
+  simReset();     //stops the timer thread
+}
+
+// Every field is derived from one counter so a snapshot mixing two publishes shows up
+static MachineState publishing;
+static void publishNext() {
+  fixed_t n = publishing.temperature[0] + 1;
+  publishing.temperature[0] = n;
+  publishing.temperature[1] = n + 1;
+  publishing.speed[0] = n + 2;
+  publishing.speed[1] = n + 3;
+  publishing.calibrationReference = n + 4;
+  publishing.ntcRaw = (uint16_t)n;
+  publishing.ntcAverage = (uint16_t)n;
+  publishing.tickLateMax_us = (uint16_t)n;
+  publishing.heaterOn = n & 1;
+  publishing.motorOn = n & 1;
+  publishing.fanOn = n & 1;
+  publishing.heaterOutput = n & 1;
+  statePublish(&publishing);
+}
+
+// Publishes much faster than CONTROL_TICK_HZ to get more overlaps with the
+// reader's copy. The 8 bit sequence still only wraps if a snapshot stalls for
+// 128 publishes (6.4 ms here).
+#define PUBLISH_PERIOD_US 50
+
+void test_snapshot_never_torn() {
+  memset(&publishing, 0, sizeof(publishing));
+  publishNext();
+  simAttachTimerInterrupt(publishNext, PUBLISH_PERIOD_US);
+  simSetRealTime(true);
+
+  unsigned long snapshots = 0;
+  fixed_t first = 0, last = 0;
+  uint64_t start_us = simMicros();
+  while (simMicros() - start_us < 500000) {
+    MachineState s;
+    stateSnapshot(&s);
+    fixed_t n = s.temperature[0];
+    if (snapshots++ == 0) first = n;
+    last = n;
+
+    TEST_ASSERT_EQUAL_INT16(n + 1, s.temperature[1]);
+    TEST_ASSERT_EQUAL_INT16(n + 2, s.speed[0]);
+    TEST_ASSERT_EQUAL_INT16(n + 3, s.speed[1]);
+    TEST_ASSERT_EQUAL_INT16(n + 4, s.calibrationReference);
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)n, s.ntcRaw);
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)n, s.ntcAverage);
+    TEST_ASSERT_EQUAL_UINT16((uint16_t)n, s.tickLateMax_us);
+    TEST_ASSERT_EQUAL_UINT8(n & 1, s.heaterOn);
+    TEST_ASSERT_EQUAL_UINT8(n & 1, s.motorOn);
+    TEST_ASSERT_EQUAL_UINT8(n & 1, s.fanOn);
+    TEST_ASSERT_EQUAL_UINT8(n & 1, s.heaterOutput);
+  }
+  simSetRealTime(false);
+  simDetachTimerInterrupt();
+
+  TEST_ASSERT_TRUE(last > first);     //the publisher actually ran concurrently
+}
+
+void test_mailbox_full() {
+  for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE - 1; i++) {
+    TEST_ASSERT_TRUE(commandPost({CMD_ADJUST, i, (fixed_t)i}));
+  }
+  TEST_ASSERT_FALSE(commandPost({CMD_ADJUST, 0xFF, 0}));
+
+  // The rejected command must not have overwritten anything
+  Command command;
+  for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE - 1; i++) {
+    TEST_ASSERT_TRUE(commandTake(&command));
+    TEST_ASSERT_EQUAL_UINT8(i, command.offset);
+  }
+  TEST_ASSERT_FALSE(commandTake(&command));
+}
+
+void test_mailbox_wrap_around() {
+  Command command;
+  for (int i = 0; i < 5 * COMMAND_QUEUE_SIZE; i++) {
+    TEST_ASSERT_TRUE(commandPost({CMD_ADJUST, (uint8_t)i, (fixed_t)(i * 3)}));
+    TEST_ASSERT_TRUE(commandPost({CMD_TOGGLE_FAN, (uint8_t)(i + 1), 0}));
+
+    TEST_ASSERT_TRUE(commandTake(&command));
+    TEST_ASSERT_EQUAL(CMD_ADJUST, command.type);
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)i, command.offset);
+    TEST_ASSERT_EQUAL_INT16(i * 3, command.value);
+
+    TEST_ASSERT_TRUE(commandTake(&command));
+    TEST_ASSERT_EQUAL(CMD_TOGGLE_FAN, command.type);
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)(i + 1), command.offset);
+  }
+}
+
+void test_mailbox_drain() {
+  Command command;
+  TEST_ASSERT_FALSE(commandTake(&command));
+
+  for (uint8_t i = 0; i < 3; i++) commandPost({CMD_ADJUST, i, 0});
+  uint8_t taken = 0;
+  while (commandTake(&command)) TEST_ASSERT_EQUAL_UINT8(taken++, command.offset);
+  TEST_ASSERT_EQUAL_UINT8(3, taken);
+
+  // Drained mailbox has its full capacity again
+  for (uint8_t i = 0; i < COMMAND_QUEUE_SIZE - 1; i++) TEST_ASSERT_TRUE(commandPost({CMD_TOGGLE_HEATER, 0, 0}));
+  TEST_ASSERT_FALSE(commandPost({CMD_TOGGLE_HEATER, 0, 0}));
+}
+
+// Consumer on the timer thread, producer here, as in the firmware
+static std::atomic<unsigned long> consumed(0);
+static uint8_t consumedNext = 0;
+static std::atomic<bool> consumedInOrder(true);
+static void consumeAll() {
+  Command command;
+  while (commandTake(&command)) {
+    if (command.offset != consumedNext) consumedInOrder = false;
+    consumedNext = command.offset + 1;
+    consumed++;
+  }
+}
+
+void test_mailbox_concurrent() {
+  consumed = 0;
+  consumedNext = 0;
+  consumedInOrder = true;
+  simAttachTimerInterrupt(consumeAll, 100);
+  simSetRealTime(true);
+
+  const unsigned long total = 2000;
+  for (unsigned long posted = 0; posted < total;) {
+    if (commandPost({CMD_ADJUST, (uint8_t)posted, 0})) posted++;
+  }
+  uint64_t start_us = simMicros();
+  while (consumed < total && simMicros() - start_us < 1000000);
+  simSetRealTime(false);
+  simDetachTimerInterrupt();
+
+  TEST_ASSERT_EQUAL_UINT32(total, consumed.load());
+  TEST_ASSERT_TRUE(consumedInOrder.load());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_snapshot_never_torn);
+  RUN_TEST(test_mailbox_full);
+  RUN_TEST(test_mailbox_wrap_around);
+  RUN_TEST(test_mailbox_drain);
+  RUN_TEST(test_mailbox_concurrent);
+  return UNITY_END();
+}